@@ -28,6 +28,100 @@ function generateStringSource(fileName)
 
 end
 
+-----------------------------------------------------------------------------------------------------------------------
+function byteArraySource(name, content)
+
+  local lines = {}
+  
+  for i = 1, #content, 16 do
+    local bytes = {}
+    for j = i, math.min(i + 15, #content) do
+      bytes[#bytes + 1] = string.format("0x%02X", content:byte(j))
+    end
+    lines[#lines + 1] = "  " .. table.concat(bytes, ", ") .. ","
+  end
+  
+  return "static const unsigned char " .. name .. "[] =\n{\n" .. table.concat(lines, "\n") .. "\n};\n"
+  
+end
+
+-----------------------------------------------------------------------------------------------------------------------
+function compressFile(fileName, command)
+
+  local tempName = fileName .. ".tmp"
+  local content = ""
+  
+  if os.execute(string.format(command, fileName, tempName)) then
+    content = readFile(tempName)
+  end
+  
+  os.remove(tempName)
+  return content
+  
+end
+
+-----------------------------------------------------------------------------------------------------------------------
+-- 64-bit FNV-1a, relies on wrapping integer arithmetic of Lua 5.3
+function contentHash(content)
+
+  local hash = 0xCBF29CE484222325
+  
+  for i = 1, #content do
+    hash = (hash ~ content:byte(i)) * 0x100000001B3
+  end
+  
+  return string.format("%016x", hash)
+  
+end
+
+-----------------------------------------------------------------------------------------------------------------------
+local assetContentTypes =
+{
+  html = "text/html", htm = "text/html", css = "text/css", js = "application/javascript", json = "application/json",
+  svg = "image/svg+xml", png = "image/png", jpg = "image/jpeg", jpeg = "image/jpeg", gif = "image/gif",
+  ico = "image/x-icon", txt = "text/plain", xml = "application/xml", wasm = "application/wasm",
+}
+
+-- Embeds file as headsocket::http_asset with gzip and brotli variants, compressed by the gzip and brotli tools
+-- when they are available. Variants that are missing or not smaller than the original are left out.
+-----------------------------------------------------------------------------------------------------------------------
+function generateAssetSource(fileName, name)
+
+  print("Generating asset source: " .. fileName)
+
+  name = name or path.getname(fileName):gsub("[^%w]", "_")
+  local extension = path.getextension(fileName):sub(2):lower()
+  local contentType = assetContentTypes[extension] or "application/octet-stream"
+
+  local variants =
+  {
+    { "identity", readFile(fileName) },
+    { "gzip", compressFile(fileName, "gzip -9 -n -c \"%s\" > \"%s\"") },
+    { "brotli", compressFile(fileName, "brotli -q 11 -c \"%s\" > \"%s\"") },
+  }
+
+  local original = variants[1][2]
+  local content = "// Generated from " .. path.getname(fileName) .. " by generateAssetSource, do not edit\n\n"
+  local fields = {}
+
+  for i, variant in ipairs(variants) do
+    local data = variant[2]
+    if i == 1 or (#data > 0 and #data < #original) then
+      content = content .. byteArraySource(name .. "_" .. variant[1], data) .. "\n"
+      fields[#fields + 1] = "  { " .. name .. "_" .. variant[1] .. ", " .. #data .. " },"
+    else
+      fields[#fields + 1] = "  { nullptr, 0 },"
+    end
+  end
+
+  content = content .. "static const headsocket::http_asset " .. name .. " =\n{\n"
+  content = content .. "  \"" .. contentType .. "\", \"" .. contentHash(original) .. "\",\n"
+  content = content .. table.concat(fields, "\n") .. "\n};\n"
+
+  writeFile(fileName .. ".asset.inl", content)
+
+end
+
 -----------------------------------------------------------------------------------------------------------------------
 function printTable(t)
 
@@ -19,7 +19,15 @@ Usage:
 
 #include <memory>
 #include <string>
-#include <map>
+#include <vector>
+#include <functional>
+
+#if defined(__cpp_impl_coroutine) && !defined(HEADSOCKET_NO_COROUTINES)
+#define HEADSOCKET_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <optional>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -31,11 +39,28 @@ class basic_tcp_server;
 class basic_tcp_client;
 class tcp_client;
 class async_tcp_client;
+struct http_request;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T> using ptr = std::shared_ptr<T>;
 typedef size_t id_t;
+typedef uint64_t timer_id;
+
+#ifdef HEADSOCKET_COROUTINES
+// Return type for connection coroutines, starts running right away and frees itself when finished
+struct task
+{
+  struct promise_type
+  {
+    task get_return_object() { return { }; }
+    std::suspend_never initial_suspend() noexcept { return { }; }
+    std::suspend_never final_suspend() noexcept { return { }; }
+    void return_void() { }
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -46,28 +71,43 @@ struct connection_impl;
 struct basic_tcp_server_impl;
 struct basic_tcp_client_impl;
 struct async_tcp_client_impl;
+struct http_handler_impl;
+struct basic_connection_pool_impl;
+struct shard;
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static bool handshake_websocket(connection &conn);
+static bool read_http_request(connection &conn, http_request &req);
+static bool is_web_socket_upgrade(const http_request &req);
+static bool accept_web_socket(connection &conn, const http_request &req);
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct less_comparator : std::binary_function<std::string, std::string, bool>
+// Incremental RFC 3629 validator, a code point can be split between successive calls
+struct utf8_validator
 {
-  bool operator()(const std::string &s1, const std::string &s2) const
-  {
-    return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(), s2.end(), [](char c1, char c2)->bool
-    {
-      return tolower(c1) < tolower(c2);
-    });
-  }
+  uint8_t needed = 0;
+  uint8_t lower = 0x80;
+  uint8_t upper = 0xBF;
+
+  bool validate(const uint8_t *ptr, size_t length);
+  bool is_complete() const { return !needed; }
+  void reset() { needed = 0; lower = 0x80; upper = 0xBF; }
 };
 
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+struct io_buffer
+{
+  const void *ptr;
+  size_t length;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 class connection
 {
 public:
@@ -86,6 +126,9 @@ public:
   bool force_write(const void *ptr, size_t length);
   bool force_read(void *ptr, size_t length);
 
+  // Gathered write of all buffers, sends as few packets as possible
+  bool force_writev(const io_buffer *buffers, size_t count);
+
   bool read_line(std::string &output);
 
 private:
@@ -112,6 +155,7 @@ struct data_block
   size_t offset;
   size_t length = 0;
   bool is_completed = false;
+  bool is_final = true;
 
   data_block(opcode opc, size_t off)
     : op(opc)
@@ -123,6 +167,46 @@ struct data_block
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Latency versus throughput trade-off for outgoing data. Asynchronous clients merge all pending blocks into one
+// flush; with a non-zero max_coalesce_delay (in microseconds) the writer waits up to that long for more blocks
+// before flushing a partially filled buffer.
+struct write_profile
+{
+  bool no_delay = true;
+  uint32_t max_coalesce_delay = 0;
+
+  static write_profile low_latency() { return write_profile(); }
+
+  static write_profile high_throughput()
+  {
+    write_profile result;
+    result.no_delay = false;
+    result.max_coalesce_delay = 500;
+    return result;
+  }
+};
+
+struct connect_options
+{
+  // Whole connect including all attempts, milliseconds
+  uint32_t timeout = 10000;
+
+  // Next resolved address is tried in parallel when previous attempts do not finish in time (Happy Eyeballs)
+  uint32_t attempt_delay = 250;
+};
+
+// Host names resolved for outbound connections are shared by all clients. Entries in use are refreshed in background
+// before they expire, failed lookups are cached too.
+class resolver_cache
+{
+public:
+  // Both in milliseconds, ttl of 0 disables caching
+  static void set_ttl(uint32_t ttl, uint32_t negativeTtl);
+  static void clear();
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 class basic_tcp_server : public std::enable_shared_from_this<basic_tcp_server>
 {
 public:
@@ -132,6 +216,37 @@ public:
   bool disconnect(ptr<basic_tcp_client> client);
   bool disconnect(id_t id);
 
+  typedef std::vector<ptr<basic_tcp_client>> client_list;
+  typedef std::shared_ptr<const client_list> client_snapshot;
+
+  // All values are in milliseconds, zero disables the timeout. Applies to clients accepted after the change.
+  struct timeouts
+  {
+    uint32_t handshake = 0;
+    uint32_t idle = 0;
+    uint32_t ping_interval = 0;
+  };
+
+  void set_timeouts(const timeouts &t);
+  timeouts get_timeouts() const;
+
+  void set_write_profile(const write_profile &profile);
+  write_profile get_write_profile() const;
+
+  // Spreads clients over count executor threads (shards), pinned to successive cores when pinToCores is set. Each
+  // shard owns its timers and work queue, a client's timers and posted work always run on its shard. Call from
+  // init(), timers scheduled on previous shards are dropped. Up to 256 shards. Returns false and keeps current
+  // shards once the first client has been accepted.
+  bool set_shards(size_t count, bool pinToCores = true);
+  size_t num_shards() const;
+
+  void post(size_t shard, std::function<void()> work);
+  void post(ptr<basic_tcp_client> client, std::function<void()> work);
+
+  timer_id add_timer(uint32_t milliseconds, std::function<void()> callback) { return add_timer(0, milliseconds, callback); }
+  timer_id add_timer(size_t shard, uint32_t milliseconds, std::function<void()> callback);
+  bool cancel_timer(timer_id id);
+
 protected:
   struct protected_tag { };
   void init() { }
@@ -148,14 +263,18 @@ protected:
 
 private:
   template <typename T> friend class tcp_server;
+  friend class basic_tcp_client;
+
+  void enqueue_disconnected(ptr<basic_tcp_client> client);
+  ptr<basic_tcp_client> find_client(id_t id) const;
+  void publish_clients() const;
 
-  void remove_disconnected() const;
+  client_snapshot snapshot_clients() const;
 
-  size_t acquire_clients() const;
-  void release_clients() const;
+  void arm_idle_timer(std::weak_ptr<basic_tcp_client> client, uint32_t delay);
+  void arm_ping_timer(std::weak_ptr<basic_tcp_client> client, uint32_t delay);
 
-  ptr<basic_tcp_client> client_at(size_t index) const;
-  size_t num_clients() const;
+  std::shared_ptr<detail::shard> shard_at(size_t index) const;
 
   void accept_thread();
   void disconnect_thread();
@@ -187,53 +306,50 @@ public:
     base_t::stop();
   }
 
+  // Immutable snapshot of connected clients, taken without locking the server. Clients accepted or removed
+  // after the snapshot was taken are not visible, but every listed client is kept alive until it is destroyed.
+  // Storage only ever holds instances created by tcp_server<T>::accept, so elements are cast statically.
   class enumerator
   {
   public:
     explicit enumerator(const tcp_server &server)
       : _server(server)
-      , _count(server.acquire_clients())
+      , _snapshot(server.snapshot_clients())
     {
 
     }
 
-    ~enumerator()
-    {
-      _server.release_clients();
-    }
-
     const tcp_server &server() const { return _server; }
-    size_t size() const { return _count; }
+    size_t size() const { return _snapshot->size(); }
 
     struct iterator
     {
-      enumerator &e;
-      size_t index;
+      client_list::const_iterator current;
 
-      iterator(enumerator &enu, size_t idx)
-        : e(enu)
-        , index(idx)
+      explicit iterator(client_list::const_iterator iter)
+        : current(iter)
       {
 
       }
 
-      bool operator==(const iterator &iter) const { return iter.index == index && &iter.e == &e; }
-      bool operator!=(const iterator &iter) const { return iter.index != index || &iter.e != &e; }
-      ptr<T> operator*() const { return std::dynamic_pointer_cast<T>(e.server().client_at(index)); }
+      bool operator==(const iterator &iter) const { return iter.current == current; }
+      bool operator!=(const iterator &iter) const { return iter.current != current; }
+      ptr<T> operator*() const { return std::static_pointer_cast<T>(*current); }
+      T *operator->() const { return static_cast<T *>(current->get()); }
 
       iterator &operator++()
       {
-        ++index;
+        ++current;
         return *this;
       }
     };
 
-    iterator begin() { return iterator(*this, 0); }
-    iterator end() { return iterator(*this, _count); }
+    iterator begin() const { return iterator(_snapshot->begin()); }
+    iterator end() const { return iterator(_snapshot->end()); }
 
   private:
     const tcp_server &_server;
-    size_t _count;
+    client_snapshot _snapshot;
   };
 
   enumerator clients() const { return enumerator(*this); }
@@ -281,14 +397,39 @@ public:
 
   ptr<basic_tcp_server> server() const;
   id_t id() const;
+  uint64_t last_activity() const;
+  size_t shard() const;
+
+  void set_write_profile(const write_profile &profile);
+
+  // Checks idle connection without blocking, pending data or close from the peer disconnect the client
+  bool probe();
+
+  // Runs work after everything previously posted to this client and never concurrently with it. Accepted clients
+  // run it on their server shard, next to their timers, clients without server run it on the posting thread.
+  void post(std::function<void()> work);
+  bool running_in_strand() const;
 
 protected:
   struct protected_tag { };
 
   friend class basic_tcp_server;
 
+  void attach(std::weak_ptr<basic_tcp_client> self, size_t shard);
+
+  // Resolves and connects without blocking the caller, callback runs on shared executor thread with nullptr when
+  // all attempts fail or time out
+  static void connect_socket(const std::string &address, int port, const connect_options &options,
+                             std::function<void(connection *)> callback);
+
+  void start_outbound(std::weak_ptr<basic_tcp_client> self);
+
   virtual void on_accept() { }
+  virtual void on_connect() { }
   virtual void on_disconnect() { }
+  virtual void on_keepalive() { }
+
+  void touch();
 
   basic_tcp_client(const std::string &address, int port);
   basic_tcp_client(ptr<basic_tcp_server> server, connection &conn);
@@ -302,7 +443,17 @@ protected:
   className(const protected_tag &, const std::string &address, int port): className(address, port) { } \
   className(const protected_tag &, headsocket::ptr<headsocket::basic_tcp_server> server, headsocket::connection &conn): className(server, conn) { } \
   static headsocket::ptr<className> create(const std::string &address, int port) { return std::make_shared<className>(protected_tag{}, address, port); } \
-  static headsocket::ptr<className> create(headsocket::ptr<headsocket::basic_tcp_server> server, headsocket::connection &conn) { return std::make_shared<className>(protected_tag{}, server, conn); }
+  static headsocket::ptr<className> create(headsocket::ptr<headsocket::basic_tcp_server> server, headsocket::connection &conn) { return std::make_shared<className>(protected_tag{}, server, conn); } \
+  static void connect_async(const std::string &address, int port, std::function<void(headsocket::ptr<className>)> callback, \
+    const headsocket::connect_options &options = headsocket::connect_options()) \
+  { \
+    connect_socket(address, port, options, [callback](headsocket::connection *conn) \
+    { \
+      headsocket::ptr<className> client = conn ? create(headsocket::ptr<headsocket::basic_tcp_server>(), *conn) : nullptr; \
+      if (client) client->start_outbound(client); \
+      callback(client); \
+    }); \
+  }
 
 #define HEADSOCKET_CLIENT_BASE(className) \
   protected: \
@@ -335,6 +486,240 @@ public:
   bool force_read(void *ptr, size_t length);
 
   bool read_line(std::string &output);
+
+#ifdef HEADSOCKET_COROUTINES
+  // Awaitable I/O, yields number of bytes transferred or invalid_operation. Sockets are polled by a shared reactor
+  // thread and the coroutine resumes on client's strand, which runs on a shared executor thread for clients without
+  // server. Keep the client alive while awaiting.
+  class io_operation
+  {
+  public:
+    bool await_ready() { return _client->io_step(*this); }
+    void await_suspend(std::coroutine_handle<> handle) { _client->io_suspend(*this, [handle]() { handle.resume(); }); }
+    size_t await_resume() const { return _result; }
+
+  private:
+    friend class tcp_client;
+
+    io_operation(tcp_client *client, uint8_t *ptr, size_t length, bool write, bool all)
+      : _client(client), _ptr(ptr), _length(length), _write(write), _all(all) { }
+
+    tcp_client *_client;
+    uint8_t *_ptr;
+    size_t _length;
+    size_t _done = 0;
+    size_t _result = 0;
+    bool _write;
+    bool _all;
+  };
+
+  io_operation read_some(void *ptr, size_t length);
+  io_operation read_all(void *ptr, size_t length);
+  io_operation write_all(const void *ptr, size_t length);
+
+private:
+  bool io_step(io_operation &op);
+  void io_suspend(io_operation &op, std::function<void()> resume);
+#endif
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class basic_connection_pool : public std::enable_shared_from_this<basic_connection_pool>
+{
+public:
+  // All per endpoint
+  struct limits
+  {
+    size_t max_idle = 8;
+    size_t max_total = 64;
+
+    // Idle connections older than this are closed instead of leased, milliseconds
+    uint32_t max_idle_time = 60000;
+  };
+
+  virtual ~basic_connection_pool();
+
+  void set_limits(const limits &l);
+  limits get_limits() const;
+
+  size_t num_idle() const;
+
+  // Closes all idle connections
+  void clear();
+
+protected:
+  struct protected_tag { };
+
+  typedef std::function<ptr<basic_tcp_client>(const std::string &, int)> factory_t;
+
+  basic_connection_pool();
+
+  // Waits in FIFO order when the endpoint is exhausted, returns nullptr on timeout or failed connect
+  ptr<basic_tcp_client> acquire_client(const std::string &address, int port, uint32_t timeout, const factory_t &factory);
+  void release_client(const std::string &address, int port, ptr<basic_tcp_client> client);
+
+private:
+  ptr<basic_tcp_client> connect_client(const std::string &address, int port, const factory_t &factory);
+
+  std::unique_ptr<detail::basic_connection_pool_impl> _p;
+};
+
+// Keeps warm outbound connections per endpoint. Leased connection goes back to the pool when its lease is released
+// or destroyed, unless it got disconnected meanwhile.
+template <typename T>
+class connection_pool : public basic_connection_pool
+{
+public:
+  class lease
+  {
+  public:
+    lease() { }
+    lease(lease &&other) = default;
+    ~lease() { release(); }
+
+    lease &operator=(lease &&other)
+    {
+      if (this != &other)
+      {
+        release();
+        _pool = std::move(other._pool);
+        _client = std::move(other._client);
+        _address = std::move(other._address);
+        _port = other._port;
+      }
+
+      return *this;
+    }
+
+    T *operator->() const { return _client.get(); }
+    const ptr<T> &get() const { return _client; }
+    explicit operator bool() const { return _client != nullptr; }
+
+    void release()
+    {
+      if (!_client)
+        return;
+
+      if (auto pool = _pool.lock())
+        static_cast<connection_pool *>(pool.get())->release_client(_address, _port, _client);
+
+      _client = nullptr;
+    }
+
+    // Closes the connection instead of returning it, ie. after a protocol error
+    void discard()
+    {
+      if (_client)
+        _client->disconnect();
+
+      release();
+    }
+
+  private:
+    friend class connection_pool;
+
+    std::weak_ptr<basic_connection_pool> _pool;
+    ptr<T> _client;
+    std::string _address;
+    int _port = 0;
+  };
+
+  connection_pool(const protected_tag &, const limits &l) { set_limits(l); }
+
+  static ptr<connection_pool> create(const limits &l = limits())
+  {
+    return std::make_shared<connection_pool>(protected_tag{}, l);
+  }
+
+  lease acquire(const std::string &address, int port, uint32_t timeout = 10000)
+  {
+    lease result;
+    result._client = std::static_pointer_cast<T>(acquire_client(address, port, timeout,
+      [](const std::string &a, int p)->ptr<basic_tcp_client> { return T::create(a, p); }));
+
+    if (result._client)
+    {
+      result._pool = shared_from_this();
+      result._address = address;
+      result._port = port;
+    }
+
+    return result;
+  }
+
+private:
+  enum { needs_tcp_client = T::is_tcp_client };
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Splits plain TCP byte stream into whole messages. Framers may keep parsing state, so every client needs its own
+// instance.
+class message_framer
+{
+public:
+  static const size_t max_framing_size = 16;
+
+  virtual ~message_framer() { }
+
+  // Returns number of bytes the next message takes including its framing, 0 when more data is needed or
+  // basic_tcp_client::invalid_operation on malformed input
+  virtual size_t read_message(const uint8_t *ptr, size_t length, size_t &payloadOffset, size_t &payloadLength) = 0;
+
+  // Both write at most max_framing_size bytes, return number of bytes written. Header may be refused with
+  // basic_tcp_client::invalid_operation when the payload cannot be framed, the message is dropped then.
+  virtual size_t write_header(uint8_t *ptr, size_t payloadLength) const = 0;
+  virtual size_t write_trailer(uint8_t *ptr) const { return 0; }
+
+  // Room message_builder reserves for the header before payload length is known
+  virtual size_t max_header_size() const { return max_framing_size; }
+
+  // Streamed messages are collected in memory first when the header depends on payload length
+  virtual bool needs_length() const { return true; }
+};
+
+class length_prefix_framer : public message_framer
+{
+public:
+  enum class prefix { u32, varint };
+
+  explicit length_prefix_framer(prefix type = prefix::u32, size_t maxMessageSize = 16 * 1024 * 1024)
+    : _type(type)
+    , _max_message_size(maxMessageSize)
+  {
+
+  }
+
+  size_t read_message(const uint8_t *ptr, size_t length, size_t &payloadOffset, size_t &payloadLength) override;
+  size_t write_header(uint8_t *ptr, size_t payloadLength) const override;
+  size_t max_header_size() const override { return _type == prefix::u32 ? 4 : 10; }
+
+private:
+  prefix _type;
+  size_t _max_message_size;
+};
+
+class delimiter_framer : public message_framer
+{
+public:
+  explicit delimiter_framer(uint8_t delimiter = '\n', size_t maxMessageSize = 16 * 1024 * 1024)
+    : _delimiter(delimiter)
+    , _max_message_size(maxMessageSize)
+  {
+
+  }
+
+  size_t read_message(const uint8_t *ptr, size_t length, size_t &payloadOffset, size_t &payloadLength) override;
+  size_t write_header(uint8_t *ptr, size_t payloadLength) const override { return 0; }
+  size_t write_trailer(uint8_t *ptr) const override { *ptr = _delimiter; return 1; }
+  size_t max_header_size() const override { return 0; }
+  bool needs_length() const override { return false; }
+
+private:
+  uint8_t _delimiter;
+  size_t _max_message_size;
+  size_t _scanned = 0;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -349,13 +734,152 @@ public:
   
   virtual ~async_tcp_client();
 
+  static const size_t stream_chunk_size = 64 * 1024;
+
   void push(const void *ptr, size_t length);
   void push(const std::string &text);
+
+  // Holds the sending queue while alive, messages pushed through it are appended without further locking and the
+  // writing thread is woken once when the batch ends. Keep it short, writing thread waits meanwhile.
+  class batch
+  {
+  public:
+    explicit batch(async_tcp_client &client);
+    ~batch();
+
+    void push(const void *ptr, size_t length, opcode op = opcode::binary);
+    void push(const std::string &text) { push(text.c_str(), text.length(), opcode::text); }
+
+  private:
+    batch(const batch &) = delete;
+    batch &operator=(const batch &) = delete;
+
+    async_tcp_client &_client;
+    size_t _count = 0;
+  };
+
+  void push_batch(const io_buffer *messages, size_t count, opcode op = opcode::binary);
+
+  // Serializes one message straight into the sending queue, framing header space is reserved up front and filled
+  // in on commit. Holds the sending queue like batch does, so keep it short. Message is dropped when the builder
+  // goes away without commit.
+  class message_builder
+  {
+  public:
+    message_builder(message_builder &&other);
+    ~message_builder();
+
+    void write(const void *ptr, size_t length);
+    // Grows the message by length bytes and returns where to put them, valid until the next write.
+    // Writes after commit (or to a moved-from builder) are ignored, reserve returns nullptr then
+    uint8_t *reserve(size_t length);
+    size_t size() const;
+    // Returns false when the framer refuses the message, ie. when it exceeds its size limit
+    bool commit();
+
+    message_builder &operator<<(const std::string &text) { write(text.c_str(), text.length()); return *this; }
+    message_builder &operator<<(const char *text) { write(text, std::char_traits<char>::length(text)); return *this; }
+    message_builder &operator<<(char c) { write(&c, 1); return *this; }
+    template <typename T> message_builder &operator<<(T value) { return *this << std::to_string(value); }
+
+  private:
+    friend class async_tcp_client;
+
+    message_builder(async_tcp_client &client, opcode op);
+    message_builder(const message_builder &) = delete;
+    message_builder &operator=(const message_builder &) = delete;
+
+    void release();
+
+    async_tcp_client *_client;
+    bool _holdsMessage;
+    size_t _headerSize = 0;
+  };
+
+  message_builder build_message(opcode op = opcode::binary);
+
+  // Received messages are handed over through a wait-free queue. Only one thread may consume them at a time, that is
+  // call peek, pop or receive.
   size_t peek() const;
   size_t pop(void *ptr, size_t length);
 
+  // Hands up to max queued messages to callback without copying and releases them at once. Pointers are valid only
+  // during the callback. Returns number of messages consumed.
+  size_t pop_batch(const std::function<void(opcode op, const uint8_t *ptr, size_t length)> &callback,
+                   size_t max = static_cast<size_t>(-1));
+
+  // Sleeps until a message is available, client disconnects or timeout (milliseconds) passes
+  bool wait_data(uint32_t timeout);
+  size_t wait_pop(void *ptr, size_t length, uint32_t timeout);
+
+  // Called from reading thread whenever new messages are queued, ie. to signal an eventfd of your own event loop.
+  // Keep it short, reading thread is blocked meanwhile.
+  void set_data_notification(std::function<void()> callback);
+
+  // Streaming writer, sends the message in stream_chunk_size fragments as they are produced. Blocks in append
+  // while previous fragments are still queued. Other data messages are held back until end_message, all three
+  // calls must be made from the same thread.
+  void begin_message(opcode op = opcode::binary);
+  void append(const void *ptr, size_t length);
+  void append(const std::string &text) { append(text.c_str(), text.length()); }
+  void end_message();
+
+  // Messages are framed by framer (if set) in both directions and delivered whole through async_received_data.
+  // Set it before the client starts its threads, ie. in the constructor.
+  void set_framer(std::unique_ptr<message_framer> framer);
+
+  // Calls async_received_data on client's strand instead of the read thread, so it runs in order with posted work.
+  // Data are copied for this and removed from the read queue regardless of the returned value.
+  void set_strand_delivery(bool enabled);
+
+#ifdef HEADSOCKET_COROUTINES
+  // Awaitable receive, yields the next data block left in the read queue or std::nullopt once disconnected. Only one
+  // receive may be pending, the coroutine resumes on client's strand. Keep the client alive while awaiting.
+  class receive_operation
+  {
+  public:
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) { return _client->wait_readable(resumer(_client, handle)); }
+
+    std::optional<std::vector<uint8_t>> await_resume()
+    {
+      std::vector<uint8_t> data;
+      return _client->pop_block(data) ? std::optional<std::vector<uint8_t>>(std::move(data)) : std::nullopt;
+    }
+
+  private:
+    friend class async_tcp_client;
+    explicit receive_operation(async_tcp_client *client): _client(client) { }
+    async_tcp_client *_client;
+  };
+
+  // Awaitable send, queues the data right away and resumes once the send queue drains to stream_chunk_size.
+  // Yields false when the client is disconnected. Any number of sends may be pending.
+  class send_operation
+  {
+  public:
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      return _client->wait_writable(stream_chunk_size, resumer(_client, handle));
+    }
+
+    bool await_resume() const { return _client->is_connected(); }
+
+  private:
+    friend class async_tcp_client;
+    explicit send_operation(async_tcp_client *client): _client(client) { }
+    async_tcp_client *_client;
+  };
+
+  receive_operation receive() { return receive_operation(this); }
+  send_operation send(const void *ptr, size_t length) { push(ptr, length); return send_operation(this); }
+  send_operation send(const std::string &text) { push(text); return send_operation(this); }
+#endif
+
 protected:
   void on_accept() override { init_threads(); }
+  void on_connect() override { init_threads(); }
   void on_disconnect() override { kill_threads(); }
 
   virtual void init_threads();
@@ -368,10 +892,31 @@ protected:
   virtual void push(const void *ptr, size_t length, opcode opcode);
 
   void kill_threads();
+  bool deliver(const data_block &db, uint8_t *ptr, size_t length);
+
+  // Hands the last block of read thread's buffer to async_received_data or the inbound queue
+  void complete_block();
 
   std::unique_ptr<detail::async_tcp_client_impl> _ap;
 
 private:
+  void push_fragment(const void *ptr, size_t length, bool isFinal);
+  void wait_drained(size_t limit);
+
+  // Both store waiter to be called once and return true, or return false when there is no need to wait
+  bool wait_readable(std::function<void()> waiter);
+  bool wait_writable(size_t limit, std::function<void()> waiter);
+  void notify_readable(bool force);
+  void notify_drained(bool force);
+  bool pop_block(std::vector<uint8_t> &data);
+
+#ifdef HEADSOCKET_COROUTINES
+  static std::function<void()> resumer(async_tcp_client *client, std::coroutine_handle<> handle)
+  {
+    return [client, handle]() { client->post([handle]() { handle.resume(); }); };
+  }
+#endif
+
   void write_thread();
   void read_thread();
 };
@@ -392,7 +937,15 @@ public:
 
   size_t peek(opcode *op) const;
 
+  // Sends close frame with status code, connection is closed once it is flushed
+  void close(uint16_t code = 1000);
+
+  // Text messages are validated as UTF-8 by default, invalid text closes the connection with code 1007
+  void set_utf8_validation(bool enabled) { _validate_utf8 = enabled; }
+
 protected:
+  void on_keepalive() override;
+
   size_t async_write_handler(uint8_t *ptr, size_t length) override;
   size_t async_read_handler(uint8_t *ptr, size_t length) override;
 
@@ -411,6 +964,8 @@ private:
 
   size_t _payload_size = 0;
   frame_header _current_header;
+  detail::utf8_validator _utf8;
+  bool _validate_utf8 = true;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -435,62 +990,274 @@ private:
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-class http_server : public tcp_server<tcp_client>
+// Non-owning reference to a string, valid only as long as the memory it points to
+struct string_ref
 {
-  HEADSOCKET_SERVER(http_server, tcp_server<tcp_client>) { }
+  static const size_t npos = static_cast<size_t>(-1);
 
-public:
-  ~http_server()
+  const char *data = nullptr;
+  size_t length = 0;
+
+  string_ref() { }
+  string_ref(const char *ptr, size_t len): data(ptr), length(len) { }
+  string_ref(const char *text): data(text), length(std::char_traits<char>::length(text)) { }
+  string_ref(const std::string &text): data(text.c_str()), length(text.length()) { }
+
+  bool empty() const { return !length; }
+  size_t size() const { return length; }
+  const char *begin() const { return data; }
+  const char *end() const { return data + length; }
+  char operator[](size_t index) const { return data[index]; }
+  std::string str() const { return std::string(data, length); }
+
+  string_ref substr(size_t pos, size_t len = npos) const
   {
-    stop();
+    pos = pos > length ? length : pos;
+    return string_ref(data + pos, len > length - pos ? length - pos : len);
   }
 
-  struct response
+  bool operator==(const string_ref &other) const
   {
-    std::string content_type = "text/html";
-    std::string message = "";
-  };
+    return length == other.length && !std::char_traits<char>::compare(data, other.data, length);
+  }
 
-  struct parameter
+  bool operator!=(const string_ref &other) const { return !(*this == other); }
+
+  bool equals_nocase(const string_ref &other) const
   {
-    std::string name;
-    std::string value;
-    bool boolean;
-    int integer;
-    double real;
-  };
+    if (length != other.length)
+      return false;
 
-  typedef std::map<std::string, parameter, detail::less_comparator> parameters_t;
+    for (size_t i = 0; i < length; ++i)
+      if (to_lower(data[i]) != to_lower(other.data[i]))
+        return false;
 
-protected:
-  virtual bool request(const std::string &path, const parameters_t &params, response &resp) { return false; }
+    return true;
+  }
 
-private:
-  bool handshake(connection &conn) final override;
+  static char to_lower(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+};
 
-  ptr<basic_tcp_client> accept(connection &conn) final override { return nullptr; }
-  void client_connected(client_ptr client) final override { }
-  void client_disconnected(client_ptr client) final override { }
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct http_header
+{
+  string_ref name;
+  string_ref value;
 };
 
-}
+// Parsed request, all fields point into the connection buffer
+struct http_request
+{
+  static const size_t max_headers = 64;
 
-#endif // __HEADSOCKET_H__
+  string_ref method;
+  string_ref target;
+  string_ref path;
+  string_ref query;
+  string_ref version;
+  http_header headers[max_headers];
+  size_t num_headers = 0;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  string_ref header(const string_ref &name) const
+  {
+    for (size_t i = 0; i < num_headers; ++i)
+      if (headers[i].name.equals_nocase(name))
+        return headers[i].value;
 
-#ifdef HEADSOCKET_IMPLEMENTATION
-#ifndef __HEADSOCKET_H_IMPL__
-#define __HEADSOCKET_H_IMPL__
+    return string_ref();
+  }
+};
 
-#include <thread>
-#include <atomic>
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Embedded file with variants compressed at build time, see generateAssetSource in etc/premake5/Utils.lua
+struct http_asset
+{
+  struct variant
+  {
+    const void *data;
+    size_t length;
+  };
+
+  const char *content_type;
+  const char *hash;
+  variant identity;
+  variant gzip;
+  variant brotli;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Routing, caching and response handling shared by http_server and web_socket_http_server
+class http_handler
+{
+public:
+  http_handler();
+  virtual ~http_handler();
+
+  struct response
+  {
+    int status = 200;
+    std::string content_type = "text/html";
+    std::string message = "";
+
+    // When set, sent instead of message without being copied, memory has to outlive the request
+    string_ref static_body;
+
+    // Extra header lines, use add_header
+    std::string headers;
+
+    // When set, body is produced by repeated calls instead of taken from message and sent with chunked transfer
+    // encoding. Generator fills up to size bytes of buffer and returns number of bytes written, 0 ends the body.
+    std::function<size_t(char *buffer, size_t size)> generator;
+
+    // With caching enabled, set to false for responses that differ between identical requests
+    bool cacheable = true;
+
+    void add_header(const string_ref &name, const string_ref &value)
+    {
+      headers.append(name.data, name.length).append(": ", 2).append(value.data, value.length).append("\r\n", 2);
+    }
+  };
+
+  // Decoded query parameter, values are parsed only when asked for
+  struct parameter
+  {
+    string_ref name;
+    string_ref value;
+
+    std::string str() const { return value.str(); }
+    int as_int(int defaultValue = 0) const;
+    double as_double(double defaultValue = 0.0) const;
+    bool as_bool() const;
+  };
+
+  // Flat list of parameters with case-insensitive lookup, valid only during the request call
+  class parameters_t
+  {
+  public:
+    static const size_t max_parameters = 64;
+
+    const parameter *begin() const { return _params; }
+    const parameter *end() const { return _params + _count; }
+    size_t size() const { return _count; }
+    bool empty() const { return !_count; }
+
+    const parameter *find(const string_ref &name) const;
+    bool contains(const string_ref &name) const { return find(name) != nullptr; }
+    string_ref value(const string_ref &name) const { auto p = find(name); return p ? p->value : string_ref(); }
+
+  private:
+    friend class http_handler;
+    friend struct detail::http_handler_impl;
+
+    parameter _params[max_parameters];
+    size_t _count = 0;
+  };
+
+  typedef std::function<bool(const http_request &req, const parameters_t &captures, const parameters_t &params, response &resp)> route_handler;
+
+  // Registers handler for method ("*" matches any) and path pattern. Pattern segments starting with ':' capture
+  // one path segment, a segment starting with '*' captures the rest of the path, e.g. "/users/:id/files/*path".
+  void route(const std::string &method, const std::string &pattern, route_handler handler);
+
+  // Serves asset on GET requests to path, choosing its precompressed variant by Accept-Encoding
+  void route_asset(const std::string &path, const http_asset &asset);
+
+  // Keeps up to maxEntries complete 200 responses to GET requests, keyed by path and query, and answers repeated
+  // requests from memory. Cached responses carry a strong ETag and revalidation gets 304 Not Modified. 0 disables.
+  void set_cache_size(size_t maxEntries);
+  void clear_cache();
+
+protected:
+  // Called for requests not matched by any route
+  virtual bool request(const std::string &path, const parameters_t &params, response &resp) { return false; }
+
+  // Answers already parsed request, the connection is not kept afterwards
+  void respond(connection &conn, http_request &req);
+
+private:
+  std::unique_ptr<detail::http_handler_impl> _hp;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Handler base comes first, so it is constructed before the server starts accepting
+class http_server : public http_handler, public tcp_server<tcp_client>
+{
+  HEADSOCKET_SERVER(http_server, tcp_server<tcp_client>) { }
+
+public:
+  ~http_server()
+  {
+    stop();
+  }
+
+private:
+  bool handshake(connection &conn) final override;
+
+  ptr<basic_tcp_client> accept(connection &conn) final override { return nullptr; }
+  void client_connected(client_ptr client) final override { }
+  void client_disconnected(client_ptr client) final override { }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Serves WebSocket connections and plain HTTP on the same port. Each request is parsed once, WebSocket upgrades
+// become clients of type <T>, any other request is answered like by http_server and the connection is closed.
+template <typename T>
+class web_socket_http_server : public http_handler, public tcp_server<T>
+{
+  HEADSOCKET_SERVER(web_socket_http_server, tcp_server<T>) { }
+
+public:
+  virtual ~web_socket_http_server()
+  {
+    base_t::stop();
+  }
+
+protected:
+  bool handshake(connection &conn) override
+  {
+    http_request req;
+
+    if (!detail::read_http_request(conn, req))
+      return false;
+
+    if (detail::is_web_socket_upgrade(req))
+      return detail::accept_web_socket(conn, req);
+
+    respond(conn, req);
+    return false;
+  }
+
+private:
+  enum { needs_web_socket_client = T::is_web_socket_client };
+};
+
+}
+
+#endif // __HEADSOCKET_H__
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef HEADSOCKET_IMPLEMENTATION
+#ifndef __HEADSOCKET_H_IMPL__
+#define __HEADSOCKET_H_IMPL__
+
+#include <thread>
+#include <atomic>
 #include <iomanip>
 #include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <sstream>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <deque>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -527,8 +1294,22 @@ private:
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#if !defined(HEADSOCKET_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define HEADSOCKET_SIMD_SSE2
+#include <emmintrin.h>
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -547,14 +1328,80 @@ typedef SOCKET socket_type;
 static const int socket_error = SOCKET_ERROR;
 static const SOCKET invalid_socket = INVALID_SOCKET;
 void close_socket(socket_type s) { closesocket(s); }
+void shutdown_socket(socket_type s) { shutdown(s, SD_BOTH); }
+typedef int socklen_type;
+typedef WSAPOLLFD pollfd_type;
+int poll_sockets(pollfd_type *fds, size_t count, int timeout) { return WSAPoll(fds, static_cast<ULONG>(count), timeout); }
+void set_non_blocking(socket_type s, bool enabled) { u_long value = enabled ? 1 : 0; ioctlsocket(s, FIONBIO, &value); }
+bool connect_in_progress() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+bool would_block() { return WSAGetLastError() == WSAEWOULDBLOCK; }
 #define HEADSOCKET_SPRINTF sprintf_s
+#define HEADSOCKET_MSG_MORE 0
+#define HEADSOCKET_MSG_DONTWAIT 0
 #elif defined(HEADSOCKET_PLATFORM_ANDROID) || defined(HEADSOCKET_PLATFORM_NIX)
 typedef int socket_type;
 static const int socket_error = -1;
 static const int invalid_socket = -1;
 void close_socket(socket_type s) { close(s); }
+void shutdown_socket(socket_type s) { shutdown(s, SHUT_RDWR); }
+typedef socklen_t socklen_type;
+typedef pollfd pollfd_type;
+int poll_sockets(pollfd_type *fds, size_t count, int timeout) { return poll(fds, static_cast<nfds_t>(count), timeout); }
+bool connect_in_progress() { return errno == EINPROGRESS; }
+bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+void set_non_blocking(socket_type s, bool enabled)
+{
+  int flags = fcntl(s, F_GETFL, 0);
+  fcntl(s, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+}
+
 #define HEADSOCKET_SPRINTF sprintf
+#ifdef MSG_MORE
+#define HEADSOCKET_MSG_MORE MSG_MORE
+#else
+#define HEADSOCKET_MSG_MORE 0
+#endif
+#ifdef MSG_DONTWAIT
+#define HEADSOCKET_MSG_DONTWAIT MSG_DONTWAIT
+#else
+#define HEADSOCKET_MSG_DONTWAIT 0
 #endif
+#endif
+
+bool poll_socket(socket_type s, bool write, int timeout)
+{
+  pollfd_type fd = { };
+  fd.fd = s;
+  fd.events = write ? POLLOUT : POLLIN;
+  return poll_sockets(&fd, 1, timeout) > 0;
+}
+
+// Blocking transfers that keep working once coroutine I/O has left the socket non-blocking (Windows), they wait
+// for readiness instead of failing with would-block
+int send_blocking(socket_type s, const char *ptr, int length)
+{
+  int result;
+  while ((result = send(s, ptr, length, 0)) == socket_error && would_block())
+    poll_socket(s, true, -1);
+
+  return result;
+}
+
+int recv_blocking(socket_type s, char *ptr, int length)
+{
+  int result;
+  while ((result = recv(s, ptr, length, 0)) == socket_error && would_block())
+    poll_socket(s, false, -1);
+
+  return result;
+}
+
+void set_no_delay(socket_type s, bool enabled)
+{
+  int value = enabled ? 1 : 0;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&value), sizeof(value));
+}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -779,6 +1626,69 @@ struct utils
     return result.str();
   }
 
+  static int hex_value(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  // Decoded string is never longer than the encoded one, returns new length
+  static size_t url_decode_inplace(char *ptr, size_t length)
+  {
+    char *output = ptr;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+      char c = ptr[i];
+      int hi, lo;
+
+      if (c == '%' && i + 2 < length && (hi = hex_value(ptr[i + 1])) >= 0 && (lo = hex_value(ptr[i + 2])) >= 0)
+      {
+        *output++ = static_cast<char>((hi << 4) | lo);
+        i += 2;
+      }
+      else if (c == '+')
+        *output++ = ' ';
+      else
+        *output++ = c;
+    }
+
+    return output - ptr;
+  }
+
+  static uint32_t count_trailing_zeros(uint32_t x)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#endif
+  }
+
+  // Returns pointer to the first occurence of ch in [ptr, end), or end
+  static const char *find_char(const char *ptr, const char *end, char ch)
+  {
+#ifdef HEADSOCKET_SIMD_SSE2
+    __m128i needle = _mm_set1_epi8(ch);
+
+    while (end - ptr >= 16)
+    {
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)), needle));
+
+      if (mask)
+        return ptr + count_trailing_zeros(static_cast<uint32_t>(mask));
+
+      ptr += 16;
+    }
+#endif
+    auto found = static_cast<const char *>(memchr(ptr, ch, end - ptr));
+    return found ? found : end;
+  }
+
   static uint16_t swap16bits(uint16_t x) { return ((x & 0x00FF) << 8) | ((x & 0xFF00) >> 8); }
 
   static uint32_t swap32bits(uint32_t x)
@@ -905,21 +1815,73 @@ struct semaphore
     mutex.unlock();
   }
 
-  void notify()
+  void notify(size_t num = 1)
   {
     {
       std::lock_guard<std::mutex> lock(mutex);
-      ++count;
+      count += num;
     }
 
     cv.notify_one();
   }
 
-  void consume() const
+  void consume(size_t num = 1) const
   {
-    if (count)
+    while (num-- && count)
       --count;
   }
+
+  // Sleeps until predicate holds (checked on every notify) or timeout passes, returns the predicate
+  template <typename Predicate>
+  bool wait_for(std::chrono::microseconds timeout, Predicate predicate) const
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, timeout, predicate);
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct blocking_queue
+{
+  std::vector<T> items;
+  bool closed = false;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  void push(T item)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      items.push_back(std::move(item));
+    }
+
+    cv.notify_one();
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+    }
+
+    cv.notify_all();
+  }
+
+  // Sleeps until there is something queued, then takes all queued items at once. Returns false when the queue
+  // is closed and there is nothing left to process.
+  bool drain(std::vector<T> &batch)
+  {
+    batch.clear();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]()->bool { return closed || !items.empty(); });
+    std::swap(batch, items);
+
+    return !batch.empty() || !closed;
+  }
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -990,6 +1952,34 @@ struct data_block_buffer
     return result;
   }
 
+  // Copies as many whole completed blocks as fit into ptr and removes them with a single buffer shift
+  size_t read_blocks(void *ptr, size_t length, size_t &numBlocks)
+  {
+    size_t result = 0;
+    numBlocks = 0;
+
+    while (numBlocks < blocks.size() && blocks[numBlocks].is_completed && result + blocks[numBlocks].length <= length)
+      result += blocks[numBlocks++].length;
+
+    if (!numBlocks)
+      return 0;
+
+    if (result)
+    {
+      memcpy(ptr, buffer.data(), result);
+      buffer.erase(buffer.begin(), buffer.begin() + result);
+    }
+
+    blocks.erase(blocks.begin(), blocks.begin() + numBlocks);
+
+    if (result) for (auto &block : blocks)
+      block.offset -= result;
+
+    return result;
+  }
+
+  bool has_block() const { return !blocks.empty() && blocks.front().is_completed; }
+
   size_t peek(opcode *op = nullptr) const
   {
     if (blocks.empty() || !blocks.front().is_completed)
@@ -1004,1197 +1994,4575 @@ struct data_block_buffer
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-bool handshake_websocket(connection &conn)
+// Unbounded single producer, single consumer queue, wait-free on both sides. Consumed nodes stay linked behind the
+// consumer and are recycled by the producer, so steady traffic does not allocate.
+template <typename T>
+struct spsc_queue
 {
-  std::string line, key;
-
-  while (conn.read_line(line))
+  struct node
   {
-    if (line.empty())
-      break;
+    T value;
+    std::atomic<node *> next = { nullptr };
+  };
 
-    if (!memcmp(line.c_str(), "Sec-WebSocket-Key: ", 19))
-      key = line.substr(19);
-  }
+  // Consumer side, the node before front
+  std::atomic<node *> tail;
 
-  if (key.empty())
-    return false;
+  // Producer side
+  node *head;
+  node *first;
+  node *tailCopy;
+  node *pending = nullptr;
 
-  key += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  spsc_queue()
+  {
+    node *n = new node();
+    tail = head = first = tailCopy = n;
+  }
 
-  detail::sha1 sha;
-  detail::sha1::digest8_t digest;
-  sha.process_bytes(key.c_str(), key.length());
+  ~spsc_queue()
+  {
+    delete pending;
 
-  std::string response = "HTTP/1.1 101 Switching Protocols\nUpgrade: websocket\nConnection: Upgrade\nSec-WebSocket-Accept: ";
-  response += detail::utils::base64_encode(sha.get_digest_bytes(digest), 20);
-  response += "\n\n";
+    for (node *n = first; n; )
+    {
+      node *next = n->next;
+      delete n;
+      n = next;
+    }
+  }
 
-  return conn.force_write(response.c_str(), response.length());
-}
+  // Producer fills returned value and makes it visible with publish
+  T &prepare()
+  {
+    if (first == tailCopy)
+      tailCopy = tail.load(std::memory_order_acquire);
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    if (first != tailCopy)
+    {
+      pending = first;
+      first = first->next.load(std::memory_order_relaxed);
+      pending->next.store(nullptr, std::memory_order_relaxed);
+    }
+    else
+      pending = new node();
 
-#ifdef HEADSOCKET_PLATFORM_WINDOWS
-void set_thread_name(const char *name)
-{
-#pragma pack(push,8)
-  typedef struct tagTHREADNAME_INFO
-  {
-    DWORD dwType;
-    LPCSTR szName;
-    DWORD dwThreadID;
-    DWORD dwFlags;
-  } THREADNAME_INFO;
-#pragma pack(pop)
-  THREADNAME_INFO info = { 0x1000, name, static_cast<DWORD>(-1), 0 };
+    return pending->value;
+  }
 
-  __try
+  void publish()
   {
-    RaiseException(0x406D1388, 0, sizeof(info) / sizeof(ULONG_PTR), reinterpret_cast<ULONG_PTR *>(&info));
+    head->next.store(pending);
+    head = pending;
+    pending = nullptr;
   }
-  __except (EXCEPTION_EXECUTE_HANDLER)
-  {
 
+  // Consumer only
+  T *front() const
+  {
+    node *next = tail.load(std::memory_order_relaxed)->next.load();
+    return next ? &next->value : nullptr;
   }
-}
-#else
-void set_thread_name(const char *name)
-{
-
-}
-#endif
 
-} // namespace detail;
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-namespace detail {
-  
-struct connection_impl
-{
-  detail::socket_type socket = detail::invalid_socket;
-  sockaddr_in from;
-  size_t id = 0;
+  void pop() { tail.store(tail.load(std::memory_order_relaxed)->next.load(std::memory_order_acquire), std::memory_order_release); }
 
-  void assign(const connection_impl &impl)
+  // Visits up to max values in place and releases all of them to the producer with a single store
+  template <typename F>
+  size_t consume(F &&visitor, size_t max)
   {
-    socket = impl.socket;
-    from = impl.from;
-    id = impl.id;
-  }
+    node *last = tail.load(std::memory_order_relaxed);
+    node *next;
+    size_t result = 0;
 
-  void close()
-  {
-    if (socket != detail::invalid_socket)
+    for (; result < max && (next = last->next.load()); ++result)
     {
-      detail::close_socket(socket);
-      socket = detail::invalid_socket;
+      visitor(next->value);
+      last = next;
     }
+
+    if (result)
+      tail.store(last, std::memory_order_release);
+
+    return result;
   }
 };
 
-}
-
-//---------------------------------------------------------------------------------------------------------------------
-connection::connection(const detail::connection_impl &impl)
-  : _p(std::make_unique<detail::connection_impl>())
+struct inbound_message
 {
-  _p->assign(impl);
-}
+  opcode op;
+  std::vector<uint8_t> data;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 //---------------------------------------------------------------------------------------------------------------------
-connection::~connection()
+bool utf8_validator::validate(const uint8_t *ptr, size_t length)
 {
-  
-}
+  const uint8_t *cursor = ptr, *end = ptr + length;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool connection::is_valid() const { return _p->socket != detail::invalid_socket; }
+  while (cursor != end)
+  {
+    if (!needed)
+    {
+      // Skip runs of ASCII characters 16 (or 8) bytes at a time
+#ifdef HEADSOCKET_SIMD_SSE2
+      while (end - cursor >= 16 && !_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cursor))))
+        cursor += 16;
+#else
+      uint64_t chunk;
+      while (end - cursor >= 8 && !((memcpy(&chunk, cursor, 8), chunk) & 0x8080808080808080ULL))
+        cursor += 8;
+#endif
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t connection::id() const { return _p->id; }
+      if (cursor == end)
+        break;
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t connection::write(const void *ptr, size_t length)
-{
-  if (!is_valid())
-    return detail::socket_error;
+      uint8_t byte = *cursor++;
 
-  if (!ptr || !length)
-    return 0;
+      if (byte < 0x80)
+        continue;
+      else if (byte >= 0xC2 && byte <= 0xDF)
+        needed = 1;
+      else if (byte >= 0xE0 && byte <= 0xEF)
+      {
+        needed = 2;
+        lower = byte == 0xE0 ? 0xA0 : 0x80;
+        upper = byte == 0xED ? 0x9F : 0xBF;
+      }
+      else if (byte >= 0xF0 && byte <= 0xF4)
+      {
+        needed = 3;
+        lower = byte == 0xF0 ? 0x90 : 0x80;
+        upper = byte == 0xF4 ? 0x8F : 0xBF;
+      }
+      else
+        return false;
+    }
+    else
+    {
+      uint8_t byte = *cursor++;
 
-  int result = send(_p->socket, static_cast<const char *>(ptr), static_cast<int>(length), 0);
+      if (byte < lower || byte > upper)
+        return false;
 
-  if (!result || result == detail::socket_error)
-    return 0;
+      lower = 0x80;
+      upper = 0xBF;
+      --needed;
+    }
+  }
 
-  return static_cast<size_t>(result);
+  return true;
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-bool connection::force_write(const void *ptr, size_t length)
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Single pass HTTP/1.x request parser working over the caller's buffer, request fields point into it. Bytes already
+// searched for the end of the header block are not searched again when more data arrive.
+struct http_parser
 {
-  if (!is_valid())
-    return false;
+  static const size_t invalid_request = static_cast<size_t>(-1);
 
-  if (!ptr)
-    return true;
+  size_t scanned = 0;
 
-  const char *chPtr = static_cast<const char *>(ptr);
+  void reset() { scanned = 0; }
 
-  while (length)
+  // Returns size of the header block once it is complete, 0 when more data are needed, or invalid_request
+  size_t parse(const char *buffer, size_t length, http_request &req)
   {
-    int result = send(_p->socket, chPtr, static_cast<int>(length), 0);
+    const char *end = buffer + length, *cursor = buffer + scanned, *headerEnd = nullptr;
 
-    if (!result || result == detail::socket_error)
-      return false;
+    while (!headerEnd)
+    {
+      const char *lineEnd = utils::find_char(cursor, end, '\n');
 
-    length -= static_cast<size_t>(result);
-    chPtr += result;
-  }
+      if (lineEnd == end)
+      {
+        scanned = length;
+        return 0;
+      }
 
-  return true;
-}
+      cursor = lineEnd + 1;
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t connection::read(void *ptr, size_t length)
-{
-  if (!is_valid())
-    return detail::socket_error;
+      if (cursor < end && *cursor == '\n')
+        headerEnd = cursor + 1;
+      else if (end - cursor >= 2 && cursor[0] == '\r' && cursor[1] == '\n')
+        headerEnd = cursor + 2;
+      else if (cursor == end || (end - cursor == 1 && *cursor == '\r'))
+      {
+        // Cannot tell yet whether an empty line follows
+        scanned = lineEnd - buffer;
+        return 0;
+      }
+    }
 
-  if (!ptr || !length)
-    return 0;
+    cursor = buffer;
+    const char *lineEnd = utils::find_char(cursor, headerEnd, '\n');
 
-  int result = recv(_p->socket, static_cast<char *>(ptr), static_cast<int>(length), 0);
+    req.method = token(cursor, lineEnd, ' ');
+    req.target = token(cursor, lineEnd, ' ');
+    req.version = trim(cursor, lineEnd);
 
-  if (!result || result == detail::socket_error)
-    return 0;
+    if (req.method.empty() || req.target.empty() || req.version.empty())
+      return invalid_request;
 
-  return static_cast<size_t>(result);
-}
+    const char *targetEnd = req.target.end();
+    const char *queryBegin = utils::find_char(req.target.begin(), targetEnd, '?');
+    req.path = string_ref(req.target.begin(), queryBegin - req.target.begin());
+    req.query = queryBegin != targetEnd ? string_ref(queryBegin + 1, targetEnd - queryBegin - 1) : string_ref();
 
-//---------------------------------------------------------------------------------------------------------------------
-bool connection::force_read(void *ptr, size_t length)
-{
-  if (!is_valid())
-    return false;
+    req.num_headers = 0;
+    cursor = lineEnd + 1;
 
-  if (!ptr)
-    return true;
+    while (cursor < headerEnd)
+    {
+      lineEnd = utils::find_char(cursor, headerEnd, '\n');
+      string_ref line = trim(cursor, lineEnd);
+      cursor = lineEnd + 1;
 
-  char *chPtr = static_cast<char *>(ptr);
+      if (line.empty())
+        break;
 
-  while (length)
+      const char *colon = utils::find_char(line.begin(), line.end(), ':');
+
+      if (colon == line.end() || req.num_headers == http_request::max_headers)
+        return invalid_request;
+
+      const char *valueBegin = colon + 1;
+      http_header &h = req.headers[req.num_headers++];
+      h.name = string_ref(line.begin(), colon - line.begin());
+      h.value = trim(valueBegin, line.end());
+    }
+
+    return headerEnd - buffer;
+  }
+
+private:
+  // Returns [cursor, delimiter) and moves cursor past the delimiter
+  static string_ref token(const char *&cursor, const char *end, char delimiter)
   {
-    int result = recv(_p->socket, chPtr, static_cast<int>(length), 0);
+    const char *found = utils::find_char(cursor, end, delimiter);
+    string_ref result(cursor, found - cursor);
+    cursor = found < end ? found + 1 : end;
+    return result;
+  }
 
-    if (!result || result == detail::socket_error)
-      return false;
+  static string_ref trim(const char *begin, const char *end)
+  {
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+      ++begin;
 
-    length -= static_cast<size_t>(result);
-    chPtr += result;
+    while (end > begin && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+      --end;
+
+    return string_ref(begin, end - begin);
   }
+};
 
-  return true;
-}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-bool connection::read_line(std::string &output)
+// Reads one request header block from connection into a reusable buffer
+struct http_request_reader
 {
-  if (!is_valid())
-    return false;
+  static const size_t max_request_size = 64 * 1024;
 
-  output = "";
+  std::vector<char> buffer;
+  size_t filled = 0;
+  http_parser parser;
 
-  while (true)
+  bool read(connection &conn, http_request &req)
   {
-    char ch;
-    int r = recv(_p->socket, &ch, 1, 0);
+    filled = 0;
+    parser.reset();
 
-    if (!r || r == detail::socket_error)
-      return false;
+    if (buffer.empty())
+      buffer.resize(4096);
 
-    if (ch == '\n')
-      break;
-    else if (ch != '\r')
-      output += ch;
-  }
+    while (true)
+    {
+      if (filled == buffer.size())
+      {
+        if (buffer.size() >= max_request_size)
+          return false;
 
-  return true;
-}
+        buffer.resize(buffer.size() * 2);
+      }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      size_t result = conn.read(buffer.data() + filled, buffer.size() - filled);
 
-namespace detail {
+      if (!result || result == static_cast<size_t>(socket_error))
+        return false;
 
-struct basic_tcp_client_ref
-{
-  size_t refCount = 0;
-  ptr<basic_tcp_client> client;
+      filled += result;
+      result = parser.parse(buffer.data(), filled, req);
 
-  basic_tcp_client_ref(ptr<basic_tcp_client> c)
-    : client(c)
-  {
-  
+      if (result == http_parser::invalid_request)
+        return false;
+      else if (result)
+        return true;
+    }
   }
 };
 
-struct basic_tcp_server_impl
-{
-  std::atomic_bool isRunning;
-  std::atomic_bool disconnectThreadQuit;
-  sockaddr_in local;
-  detail::lockable_value<std::vector<basic_tcp_client_ref>> connections;
-  detail::semaphore disconnectSemaphore;
-  int port = 0;
-  detail::socket_type serverSocket = invalid_socket;
-  std::unique_ptr<std::thread> acceptThread;
-  std::unique_ptr<std::thread> disconnectThread;
-  id_t nextClientID = 1;
-
-  basic_tcp_server_impl()
-  {
-    isRunning = false;
-    disconnectThreadQuit = false;
-  }
-};
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+inline uint64_t clock_ms()
+{
+  using namespace std::chrono;
+  return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-basic_tcp_server::basic_tcp_server(int port)
-  : _p(std::make_unique<detail::basic_tcp_server_impl>())
+// Hashed hierarchical timer wheel, 4 levels of 256 slots each. One tick is one millisecond, so timers up to ~49 days
+// are supported. Scheduling and cancelling are O(1), timers are cascaded one level down as the wheel turns. Not thread
+// safe, expired callbacks are collected and must be invoked by the caller (outside of any lock).
+struct timer_wheel
 {
-#ifdef HEADSOCKET_PLATFORM_WINDOWS
-  WSADATA wsaData;
-  WSAStartup(0x101, &wsaData);
-#endif
-
-  _p->local.sin_family = AF_INET;
-  _p->local.sin_addr.s_addr = INADDR_ANY;
-  _p->local.sin_port = htons(static_cast<unsigned short>(port));
-
-  _p->serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+  typedef std::function<void()> callback_t;
 
-  if (bind(_p->serverSocket, reinterpret_cast<sockaddr *>(&_p->local), sizeof(_p->local)) != 0)
-    return;
+  static const uint32_t slot_bits = 8;
+  static const uint32_t num_slots = 1 << slot_bits;
+  static const uint32_t num_levels = 4;
+  static const uint32_t invalid_node = static_cast<uint32_t>(-1);
+  static const uint64_t max_delay = (1ULL << (slot_bits * num_levels)) - 1;
 
-  if (listen(_p->serverSocket, 8))
-    return;
+  // Top 8 bits of timer_id are left free for the owner of the wheel
+  static const uint32_t generation_mask = 0x00FFFFFF;
 
-  _p->isRunning = true;
-  _p->port = port;
-  _p->acceptThread = std::make_unique<std::thread>(std::bind(&basic_tcp_server::accept_thread, this));
-  _p->disconnectThread = std::make_unique<std::thread>(std::bind(&basic_tcp_server::disconnect_thread, this));
-}
+  struct node
+  {
+    uint64_t deadline = 0;
+    uint32_t generation = 1;
+    uint32_t prev = invalid_node;
+    uint32_t next = invalid_node;
+    uint32_t *head = nullptr;
+    callback_t callback;
+  };
 
-//---------------------------------------------------------------------------------------------------------------------
-basic_tcp_server::~basic_tcp_server()
-{
-  stop();
+  std::vector<node> nodes;
+  std::vector<uint32_t> freeNodes;
+  uint32_t slots[num_levels][num_slots];
+  uint64_t now = 0;
 
-#ifdef HEADSOCKET_PLATFORM_WINDOWS
-  WSACleanup();
-#endif
-}
+  timer_wheel()
+  {
+    for (auto &level : slots)
+      for (auto &slot : level)
+        slot = invalid_node;
+  }
 
-//---------------------------------------------------------------------------------------------------------------------
-int basic_tcp_server::port() const { return _p->port; }
+  size_t size() const { return nodes.size() - freeNodes.size(); }
 
-//---------------------------------------------------------------------------------------------------------------------
-void basic_tcp_server::stop()
-{
-  if (_p->isRunning.exchange(false))
+  timer_id schedule(uint64_t delay, callback_t callback)
   {
-    detail::close_socket(_p->serverSocket);
+    uint32_t index;
 
+    if (freeNodes.empty())
     {
-      acquire_clients();
-
-      for (size_t i = 0, S = num_clients(); i < S; ++i)
-        client_at(i)->disconnect();
-
-      release_clients();
+      index = static_cast<uint32_t>(nodes.size());
+      nodes.emplace_back();
     }
-
-    if (_p->acceptThread)
+    else
     {
-      _p->acceptThread->join();
-      _p->acceptThread = nullptr;
+      index = freeNodes.back();
+      freeNodes.pop_back();
     }
 
-    if (_p->disconnectThread)
-    {
-      _p->disconnectThreadQuit = true;
-      _p->disconnectSemaphore.notify();
+    node &n = nodes[index];
+    n.deadline = now + (delay ? (delay > max_delay ? max_delay : delay) : 1);
+    n.callback = std::move(callback);
+    link(index);
 
-      _p->disconnectThread->join();
-      _p->disconnectThread = nullptr;
-    }
+    return (static_cast<timer_id>(n.generation) << 32) | index;
   }
-}
 
-//---------------------------------------------------------------------------------------------------------------------
-bool basic_tcp_server::is_running() const { return _p->isRunning; }
+  bool cancel(timer_id id)
+  {
+    uint32_t index = static_cast<uint32_t>(id);
 
-//---------------------------------------------------------------------------------------------------------------------
-bool basic_tcp_server::disconnect(ptr<basic_tcp_client> client)
-{
-  bool found = false;
+    if (index >= nodes.size() || nodes[index].generation != static_cast<uint32_t>(id >> 32) || !nodes[index].head)
+      return false;
 
-  if (client)
+    unlink(index);
+    release(index);
+    return true;
+  }
+
+  void advance(uint64_t ticks, std::vector<callback_t> &expired)
   {
+    while (ticks--)
     {
-      HEADSOCKET_LOCK(_p->connections);
-      for (size_t i = 0, S = _p->connections->size(); i < S; ++i)
-        if (_p->connections->at(i).client == client)
-        {
-          found = true;
-          break;
-        }
-    }
+      ++now;
 
-    if (found && !client->disconnect())
-    {
-      client_disconnected(client);
-      _p->disconnectSemaphore.notify();
+      uint32_t level = 0;
+      while (level + 1 < num_levels && !(now & ((1ULL << ((level + 1) * slot_bits)) - 1)))
+        ++level;
+
+      for (; level > 0; --level)
+        cascade(level);
+
+      uint32_t &head = slots[0][now & (num_slots - 1)];
+
+      while (head != invalid_node)
+      {
+        uint32_t index = head;
+        unlink(index);
+        expired.push_back(std::move(nodes[index].callback));
+        release(index);
+      }
     }
   }
 
-  return found;
-}
+private:
+  void link(uint32_t index)
+  {
+    node &n = nodes[index];
+    uint64_t delta = n.deadline > now ? n.deadline - now : 0;
+    uint32_t level = 0;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool basic_tcp_server::disconnect(id_t id)
-{
-  bool found = false;
+    while (level + 1 < num_levels && delta >= (1ULL << ((level + 1) * slot_bits)))
+      ++level;
 
-  if (id)
+    n.head = &slots[level][(n.deadline >> (level * slot_bits)) & (num_slots - 1)];
+    n.prev = invalid_node;
+    n.next = *n.head;
+
+    if (n.next != invalid_node)
+      nodes[n.next].prev = index;
+
+    *n.head = index;
+  }
+
+  void unlink(uint32_t index)
   {
-    ptr<basic_tcp_client> client;
+    node &n = nodes[index];
 
-    {
-      HEADSOCKET_LOCK(_p->connections);
-      for (size_t i = 0, S = _p->connections->size(); i < S; ++i)
-        if (_p->connections->at(i).client->id() == id)
-        {
-          client = _p->connections->at(i).client;
-          found = true;
-          break;
-        }
-    }
+    if (n.prev != invalid_node)
+      nodes[n.prev].next = n.next;
+    else
+      *n.head = n.next;
 
-    if (found && !client->disconnect())
+    if (n.next != invalid_node)
+      nodes[n.next].prev = n.prev;
+
+    n.head = nullptr;
+    n.prev = n.next = invalid_node;
+  }
+
+  void release(uint32_t index)
+  {
+    node &n = nodes[index];
+    n.callback = nullptr;
+
+    if (!(n.generation = (n.generation + 1) & generation_mask))
+      n.generation = 1;
+
+    freeNodes.push_back(index);
+  }
+
+  void cascade(uint32_t level)
+  {
+    uint32_t &head = slots[level][(now >> (level * slot_bits)) & (num_slots - 1)];
+    uint32_t index = head;
+    head = invalid_node;
+
+    while (index != invalid_node)
     {
-      client_disconnected(client);
-      _p->disconnectSemaphore.notify();
+      uint32_t next = nodes[index].next;
+      link(index);
+      index = next;
     }
   }
+};
 
-  return found;
-}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 //---------------------------------------------------------------------------------------------------------------------
-ptr<basic_tcp_client> basic_tcp_server::client_at(size_t index) const
+bool read_http_request(connection &conn, http_request &req)
 {
-  HEADSOCKET_LOCK(_p->connections);
-  return index < _p->connections->size() ? _p->connections->at(index).client : nullptr;
+  static thread_local http_request_reader reader;
+  return reader.read(conn, req);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-size_t basic_tcp_server::num_clients() const
+bool is_web_socket_upgrade(const http_request &req)
 {
-  HEADSOCKET_LOCK(_p->connections);
-  return _p->connections->size();
+  return req.header("Upgrade").equals_nocase("websocket") && !req.header("Sec-WebSocket-Key").empty();
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-size_t basic_tcp_server::acquire_clients() const
+bool handshake_websocket(connection &conn)
 {
-  HEADSOCKET_LOCK(_p->connections);
-
-  for (auto &clientRef : _p->connections.value)
-    ++clientRef.refCount;
-
-  return _p->connections->size();
+  http_request req;
+  return read_http_request(conn, req) && accept_web_socket(conn, req);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-void basic_tcp_server::release_clients() const
+bool accept_web_socket(connection &conn, const http_request &req)
 {
-  HEADSOCKET_LOCK(_p->connections);
+  std::string key = req.header("Sec-WebSocket-Key").str();
+
+  if (key.empty())
+    return false;
+
+  key += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
-  for (auto &clientRef : _p->connections.value)
-    --clientRef.refCount;
+  detail::sha1 sha;
+  detail::sha1::digest8_t digest;
+  sha.process_bytes(key.c_str(), key.length());
+
+  std::string response = "HTTP/1.1 101 Switching Protocols\nUpgrade: websocket\nConnection: Upgrade\nSec-WebSocket-Accept: ";
+  response += detail::utils::base64_encode(sha.get_digest_bytes(digest), 20);
+  response += "\n\n";
 
-  remove_disconnected();
+  return conn.force_write(response.c_str(), response.length());
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-void basic_tcp_server::remove_disconnected() const
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef HEADSOCKET_PLATFORM_WINDOWS
+void set_thread_name(const char *name)
 {
-  size_t i = 0;
+#pragma pack(push,8)
+  typedef struct tagTHREADNAME_INFO
+  {
+    DWORD dwType;
+    LPCSTR szName;
+    DWORD dwThreadID;
+    DWORD dwFlags;
+  } THREADNAME_INFO;
+#pragma pack(pop)
+  THREADNAME_INFO info = { 0x1000, name, static_cast<DWORD>(-1), 0 };
 
-  while (i < _p->connections->size())
+  __try
+  {
+    RaiseException(0x406D1388, 0, sizeof(info) / sizeof(ULONG_PTR), reinterpret_cast<ULONG_PTR *>(&info));
+  }
+  __except (EXCEPTION_EXECUTE_HANDLER)
   {
-    auto &clientRef = _p->connections.value[i];
 
-    if (!clientRef.client->is_connected() && clientRef.refCount == 0)
-    {
-      clientRef.client->on_disconnect();
-      _p->connections->erase(_p->connections->begin() + i);
-    }
-    else
-      ++i;
   }
 }
+#else
+void set_thread_name(const char *name)
+{
+
+}
+#endif
 
 //---------------------------------------------------------------------------------------------------------------------
-void basic_tcp_server::accept_thread()
+bool pin_thread(size_t cpu)
 {
-  detail::set_thread_name("BaseTcpServer::acceptThread");
+#if defined(HEADSOCKET_PLATFORM_WINDOWS)
+  return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (cpu % (sizeof(DWORD_PTR) * 8))) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % CPU_SETSIZE, &set);
+  return !sched_setaffinity(0, sizeof(set), &set);
+#else
+  return false;
+#endif
+}
 
-  while (_p->isRunning)
-  {
-    detail::connection_impl conn_impl;
-    conn_impl.socket = ::accept(_p->serverSocket, reinterpret_cast<struct sockaddr *>(&conn_impl.from), nullptr);
-    conn_impl.id = _p->nextClientID++;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    if (!_p->nextClientID)
-      ++_p->nextClientID;
+// Executor thread with its own timer wheel and queue of posted work
+struct shard
+{
+  static const uint32_t timer_resolution = 10;
 
-    if (!_p->isRunning)
-      break;
+  lockable_value<timer_wheel> timers;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::function<void()>> posted;
+  bool quit = false;
+  std::unique_ptr<std::thread> thread;
 
-    if (conn_impl.socket != detail::invalid_socket)
+  void start(int cpu)
+  {
+    thread = std::make_unique<std::thread>([this, cpu]() { run(cpu); });
+  }
+
+  void stop()
+  {
     {
-      connection conn(conn_impl);
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
 
-      ptr<basic_tcp_client> newClient;
-      bool failed = false;
+    cv.notify_all();
 
-      if (handshake(conn))
-      {
-        if (newClient = accept(conn))
-        {
-          newClient->on_accept();
+    if (thread)
+    {
+      thread->join();
+      thread = nullptr;
+    }
+  }
 
-          HEADSOCKET_LOCK(_p->connections);
-          _p->connections->push_back(newClient);
-        }
-        else
-          failed = true;
-      }
-      else
-        failed = true;
+  // Stopped shard refuses work and leaves it untouched, so the caller can run it elsewhere
+  bool post(std::function<void()> &&work)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
 
-      if (failed)
-      {
-        conn_impl.close();
-        --_p->nextClientID;
+      if (quit)
+        return false;
 
-        if (!_p->nextClientID)
-          --_p->nextClientID;
-      }
-      else
-        client_connected(newClient);
+      posted.push_back(std::move(work));
     }
-  }
-}
 
-//---------------------------------------------------------------------------------------------------------------------
-void basic_tcp_server::disconnect_thread()
-{
-  detail::set_thread_name("BaseTcpServer::disconnectThread");
+    cv.notify_one();
+    return true;
+  }
 
-  while (!_p->disconnectThreadQuit)
+  void run(int cpu)
   {
+    set_thread_name("BaseTcpServer::shardThread");
+
+    if (cpu >= 0)
+      pin_thread(static_cast<size_t>(cpu));
+
+    std::vector<std::function<void()>> work;
+    std::vector<timer_wheel::callback_t> expired;
+    uint64_t last = clock_ms();
+
+    while (true)
     {
-      HEADSOCKET_LOCK(_p->disconnectSemaphore);
-      HEADSOCKET_LOCK(_p->connections);
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::milliseconds(static_cast<uint32_t>(timer_resolution)), [this]()->bool { return quit || !posted.empty(); });
 
-      remove_disconnected();
-      _p->disconnectSemaphore.consume();
-    }
-  }
-}
+        // Work accepted before stop still runs, strands waiting for it would never be scheduled again
+        if (quit && posted.empty())
+          break;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        std::swap(work, posted);
+      }
 
-namespace detail {
+      for (auto &w : work)
+        w();
 
-struct basic_tcp_client_impl
-{
-  std::atomic_int refCount;
-  std::atomic_bool isConnected;
-  std::weak_ptr<basic_tcp_server> server;
-  connection conn = detail::connection_impl();
-  std::string address = "";
-  int port = 0;
+      work.clear();
 
-  basic_tcp_client_impl()
-  {
-    refCount = 0;
-    isConnected = false;
+      uint64_t now = clock_ms();
+
+      if (now != last)
+      {
+        HEADSOCKET_LOCK(timers);
+        timers->advance(now - last, expired);
+        last = now;
+      }
+
+      for (auto &callback : expired)
+        callback();
+
+      expired.clear();
+    }
   }
 };
 
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-basic_tcp_client::basic_tcp_client(const std::string &address, int port)
-  : _p(std::make_unique<detail::basic_tcp_client_impl>())
+// Serial executor, work posted from any thread runs in posting order and never concurrently. Posting is a lock-free
+// push to an intrusive MPSC queue, only the post that finds the strand idle schedules a drain through dispatch.
+struct strand : std::enable_shared_from_this<strand>
 {
-  struct addrinfo *result = nullptr, *ptr = nullptr, hints;
+  // Long queues are drained in batches, so one busy strand cannot starve others sharing the thread
+  static const size_t max_batch = 64;
 
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_TCP;
+  struct node
+  {
+    std::function<void()> work;
+    std::atomic<node *> next = { nullptr };
+  };
 
-  char buff[16];
-  HEADSOCKET_SPRINTF(buff, "%d", port);
+  std::function<void(std::function<void()>)> dispatch;
+  std::atomic<node *> head;
+  std::atomic<size_t> pending = { 0 };
+  std::atomic<std::thread::id> runner;
+  node *tail;
+  node stub;
 
-  if (getaddrinfo(address.c_str(), buff, &hints, &result))
-    return;
+  strand(): head(&stub), tail(&stub) { }
 
-  for (ptr = result; ptr != nullptr; ptr = ptr->ai_next)
+  ~strand()
   {
-    _p->conn.impl()->socket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+    for (node *n = tail; n; )
+    {
+      node *next = n->next;
+      if (n != &stub) delete n;
+      n = next;
+    }
+  }
 
-    if (!_p->conn.is_valid())
-      return;
+  void post(std::function<void()> work)
+  {
+    node *n = new node();
+    n->work = std::move(work);
+    head.exchange(n)->next = n;
+
+    if (!pending++)
+      schedule();
+  }
 
-    if (connect(_p->conn.impl()->socket, ptr->ai_addr, static_cast<int>(ptr->ai_addrlen)) == detail::socket_error)
+  void schedule()
+  {
+    if (!dispatch)
     {
-      detail::close_socket(_p->conn.impl()->socket);
-      _p->conn.impl()->socket = detail::invalid_socket;
-      continue;
+      run();
+      return;
     }
 
-    break;
+    auto self = shared_from_this();
+    dispatch([self]() { self->run(); });
   }
 
-  freeaddrinfo(result);
-
-  if (!_p->conn.is_valid())
-    return;
+  void run()
+  {
+    runner = std::this_thread::get_id();
 
-  _p->address = address;
-  _p->port = port;
-  _p->isConnected = true;
-}
+    for (size_t count = 1; ; ++count)
+    {
+      node *next;
 
-//---------------------------------------------------------------------------------------------------------------------
-basic_tcp_client::basic_tcp_client(ptr<basic_tcp_server> server, connection &conn)
-  : _p(std::make_unique<detail::basic_tcp_client_impl>())
-{
-  _p->server = server;
-  _p->conn.impl()->assign(*(conn.impl()));
-  _p->isConnected = true;
-}
+      // Producer has already counted the node, but might not have linked it yet
+      while (!(next = tail->next))
+        std::this_thread::yield();
 
-//---------------------------------------------------------------------------------------------------------------------
-basic_tcp_client::~basic_tcp_client()
-{
-  disconnect();
-}
+      if (tail != &stub)
+        delete tail;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool basic_tcp_client::disconnect()
-{
-  bool wasConnected = _p->isConnected.exchange(false);
+      tail = next;
+      std::function<void()> work = std::move(next->work);
+      work();
 
-  if (wasConnected)
-  {
-    _p->conn.impl()->close();
+      if (--pending == 0)
+        break;
 
-    ptr<basic_tcp_server> s = server();
+      if (count == max_batch && dispatch)
+      {
+        runner = std::thread::id();
+        schedule();
+        return;
+      }
+    }
 
-    if (s)
-      s->disconnect(_p->conn.id());
+    runner = std::thread::id();
   }
+};
 
-  return wasConnected;
-}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-bool basic_tcp_client::is_connected() const { return _p->isConnected; }
+// Readiness poller for awaiting coroutines and outbound connects. Every watch fires once, with false when its deadline
+// passes first. All sockets are polled on one thread which is woken by a datagram sent to itself whenever a watch is
+// added.
+struct reactor
+{
+  struct watch_entry
+  {
+    socket_type socket;
+    bool write;
+    uint64_t deadline;
+    std::function<void(bool)> callback;
+  };
 
-//---------------------------------------------------------------------------------------------------------------------
-ptr<basic_tcp_server> basic_tcp_client::server() const { return _p->server.lock(); }
+  std::mutex mutex;
+  std::vector<watch_entry> added;
+  socket_type wakeup = invalid_socket;
+  std::atomic_bool quit = { false };
+  std::unique_ptr<std::thread> thread;
 
-//---------------------------------------------------------------------------------------------------------------------
-id_t basic_tcp_client::id() const { return _p->conn.id(); }
+  static reactor &instance()
+  {
+    static reactor result;
+    return result;
+  }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  reactor()
+  {
+    sockaddr_in local = { };
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_type localLength = sizeof(local);
 
-//---------------------------------------------------------------------------------------------------------------------
-tcp_client::tcp_client(const std::string &address, int port)
-  : base_t(address, port)
-{
+    wakeup = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    bind(wakeup, reinterpret_cast<sockaddr *>(&local), sizeof(local));
+    getsockname(wakeup, reinterpret_cast<sockaddr *>(&local), &localLength);
+    connect(wakeup, reinterpret_cast<sockaddr *>(&local), sizeof(local));
 
-}
+    thread = std::make_unique<std::thread>([this]() { run(); });
+  }
 
-//---------------------------------------------------------------------------------------------------------------------
-tcp_client::tcp_client(ptr<basic_tcp_server> server, connection &conn)
-  : base_t(server, conn)
-{
+  ~reactor()
+  {
+    quit = true;
+    notify();
+    thread->join();
+    close_socket(wakeup);
+  }
 
-}
+  // Deadline is in clock_ms() time, 0 waits forever
+  void watch(socket_type s, bool write, uint64_t deadline, std::function<void(bool)> callback)
+  {
+    {
+      HEADSOCKET_LOCK(mutex);
+      added.push_back({ s, write, deadline, std::move(callback) });
+    }
 
-//---------------------------------------------------------------------------------------------------------------------
-tcp_client::~tcp_client()
-{
+    notify();
+  }
 
-}
+  void notify()
+  {
+    char signal = 0;
+    send(wakeup, &signal, 1, 0);
+  }
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t tcp_client::write(const void *ptr, size_t length) { return _p->conn.write(ptr, length); }
+  void run()
+  {
+    set_thread_name("Reactor");
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t tcp_client::read(void *ptr, size_t length) { return _p->conn.read(ptr, length); }
+    std::vector<watch_entry> watches, fired, expired;
+    std::vector<pollfd_type> fds;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool tcp_client::force_write(const void *ptr, size_t length) { return _p->conn.force_write(ptr, length); }
+    while (!quit)
+    {
+      {
+        HEADSOCKET_LOCK(mutex);
+        for (auto &w : added) watches.push_back(std::move(w));
+        added.clear();
+      }
 
-//---------------------------------------------------------------------------------------------------------------------
-bool tcp_client::force_read(void *ptr, size_t length) { return _p->conn.force_read(ptr, length); }
+      fds.resize(watches.size() + 1);
+      fds[0] = { };
+      fds[0].fd = wakeup;
+      fds[0].events = POLLIN;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool tcp_client::read_line(std::string &output) { return _p->conn.read_line(output); }
+      uint64_t now = clock_ms(), nearest = 0;
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      for (size_t i = 0; i < watches.size(); ++i)
+      {
+        fds[i + 1] = { };
+        fds[i + 1].fd = watches[i].socket;
+        fds[i + 1].events = watches[i].write ? POLLOUT : POLLIN;
 
-namespace detail {
+        if (watches[i].deadline && (!nearest || watches[i].deadline < nearest))
+          nearest = watches[i].deadline;
+      }
 
-struct async_tcp_client_impl
-{
-  detail::semaphore writeSemaphore;
-  detail::lockable_value<detail::data_block_buffer> writeBlocks;
-  detail::lockable_value<detail::data_block_buffer> readBlocks;
-  std::unique_ptr<std::thread> writeThread;
-  std::unique_ptr<std::thread> readThread;
-  std::atomic_int threadCounter = { 0 };
-};
+      int timeout = !nearest ? -1 : (nearest > now ? static_cast<int>(nearest - now) : 0);
 
-}
+      if (poll_sockets(fds.data(), fds.size(), timeout) < 0)
+        continue;
+
+      if (fds[0].revents)
+      {
+        char signals[64];
+        while (poll_socket(wakeup, false, 0) && recv(wakeup, signals, sizeof(signals), 0) > 0);
+      }
+
+      // Errors and hangups fire the watch too, the failure is picked up by the following recv, send or getsockopt
+      now = clock_ms();
+      size_t kept = 0;
+      for (size_t i = 0; i < watches.size(); ++i)
+      {
+        if (fds[i + 1].revents)
+          fired.push_back(std::move(watches[i]));
+        else if (watches[i].deadline && watches[i].deadline <= now)
+          expired.push_back(std::move(watches[i]));
+        else if (kept++ != i)
+          watches[kept - 1] = std::move(watches[i]);
+      }
+
+      watches.resize(kept);
+
+      for (auto &w : fired)
+        w.callback(true);
+
+      for (auto &w : expired)
+        w.callback(false);
+
+      fired.clear();
+      expired.clear();
+    }
+  }
+};
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-async_tcp_client::async_tcp_client(const std::string &address, int port)
-  : base_t(address, port)
-  , _ap(std::make_unique<detail::async_tcp_client_impl>())
+// Runs user code the reactor would otherwise run on its polling thread: completed async connects and strands of
+// clients without server woken after co_await. Strands whose server or shard is gone fall back to it as well.
+struct executor
 {
-  
-}
+  blocking_queue<std::function<void()>> queue;
+  std::unique_ptr<std::thread> thread;
 
-//---------------------------------------------------------------------------------------------------------------------
-async_tcp_client::async_tcp_client(ptr<basic_tcp_server> server, connection &conn)
-  : base_t(server, conn)
-  , _ap(new detail::async_tcp_client_impl())
+  static executor &instance()
+  {
+    static executor result;
+    return result;
+  }
+
+  executor()
+  {
+    thread = std::make_unique<std::thread>([this]()
+    {
+      set_thread_name("Executor");
+
+      std::vector<std::function<void()>> work;
+      while (queue.drain(work))
+        for (auto &w : work)
+          w();
+    });
+  }
+
+  ~executor()
+  {
+    queue.close();
+    thread->join();
+  }
+
+  void post(std::function<void()> work) { queue.push(std::move(work)); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct endpoint
 {
-  
-}
+  sockaddr_storage address;
+  socklen_type length;
+};
 
-//---------------------------------------------------------------------------------------------------------------------
-async_tcp_client::~async_tcp_client()
+// Resolved addresses are interleaved by family, so that an unreachable family costs one attempt delay at most
+bool resolve(const std::string &address, int port, std::vector<endpoint> &result)
 {
-  disconnect();
+  struct addrinfo *list = nullptr, hints;
+  result.clear();
 
-  _ap->writeSemaphore.notify();
-  _ap->writeThread->join();
-  _ap->readThread->join();
-}
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::push(const void *ptr, size_t length, opcode opcode)
-{
-  if (!ptr)
-    return;
+  char buff[16];
+  HEADSOCKET_SPRINTF(buff, "%d", port);
+
+  if (getaddrinfo(address.c_str(), buff, &hints, &list))
+    return false;
+
+  std::vector<endpoint> families[2];
+  int firstFamily = list ? list->ai_family : AF_INET;
 
+  for (auto info = list; info; info = info->ai_next)
   {
-    HEADSOCKET_LOCK(_ap->writeBlocks);
-    _ap->writeBlocks->block_begin(opcode);
-    _ap->writeBlocks->write(ptr, length);
-    _ap->writeBlocks->block_end();
+    endpoint e = { };
+    memcpy(&e.address, info->ai_addr, info->ai_addrlen);
+    e.length = static_cast<socklen_type>(info->ai_addrlen);
+    families[info->ai_family == firstFamily ? 0 : 1].push_back(e);
   }
 
-  _ap->writeSemaphore.notify();
-}
+  freeaddrinfo(list);
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::push(const void *ptr, size_t length)
-{
-  push(ptr, length, opcode::binary);
-}
+  for (size_t i = 0; i < families[0].size() || i < families[1].size(); ++i)
+    for (auto &family : families)
+      if (i < family.size())
+        result.push_back(family[i]);
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::push(const std::string &text)
-{
-  push(text.c_str(), text.length(), opcode::text);
+  return !result.empty();
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t async_tcp_client::peek() const
-{
-  HEADSOCKET_LOCK(_ap->readBlocks);
-  return _ap->readBlocks->peek(nullptr);
-}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t async_tcp_client::pop(void *ptr, size_t length)
+// Starts non-blocking connect, returns invalid_socket when the attempt fails right away
+socket_type open_attempt(const endpoint &e)
 {
-  if (!ptr)
-    return invalid_operation;
+  socket_type s = socket(e.address.ss_family, SOCK_STREAM, IPPROTO_TCP);
 
-  if (!length)
-    return 0;
+  if (s == invalid_socket)
+    return invalid_socket;
 
-  HEADSOCKET_LOCK(_ap->readBlocks);
-  return _ap->readBlocks->read(ptr, length);
-}
+  set_non_blocking(s, true);
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::init_threads()
-{
-  _ap->threadCounter = 0;
-  _ap->writeThread = std::make_unique<std::thread>(std::bind(&async_tcp_client::write_thread, this));
-  _ap->readThread = std::make_unique<std::thread>(std::bind(&async_tcp_client::read_thread, this));
+  if (connect(s, reinterpret_cast<const sockaddr *>(&e.address), e.length) == socket_error && !connect_in_progress())
+  {
+    close_socket(s);
+    return invalid_socket;
+  }
+
+  return s;
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::write_thread()
+// Races connection attempts on the reactor: whenever pending attempts do not finish within attempt delay, the next
+// endpoint is started in parallel. First connected socket wins, the others are shut down and closed once they fire.
+struct connect_operation : std::enable_shared_from_this<connect_operation>
 {
-  ++_ap->threadCounter;
-  detail::set_thread_name("AsyncTcpClient::writeThread");
+  std::mutex mutex;
+  std::vector<endpoint> endpoints;
+  std::vector<socket_type> attempts;
+  size_t next = 0;
+  uint64_t deadline = 0;
+  uint32_t attemptDelay = 0;
+  bool done = false;
+  std::function<void(socket_type)> callback;
+
+  void start()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
 
-  std::vector<uint8_t> buffer(1024 * 1024);
+    if (!start_next())
+      finish(invalid_socket, lock);
+  }
 
-  while (_p->isConnected)
+  // Caller holds the lock
+  bool start_next()
   {
-    size_t written = 0;
+    while (next < endpoints.size())
     {
-      HEADSOCKET_LOCK(_ap->writeSemaphore);
+      socket_type s = open_attempt(endpoints[next++]);
 
-      if (!_p->isConnected)
-        break;
+      if (s == invalid_socket)
+        continue;
 
-      written = async_write_handler(buffer.data(), buffer.size());
+      attempts.push_back(s);
+
+      uint64_t wake = clock_ms() + attemptDelay;
+      watch(s, next < endpoints.size() && wake < deadline ? wake : deadline);
+      return true;
     }
 
-    if (written == invalid_operation)
-      break;
+    return false;
+  }
 
-    if (!written)
-      buffer.resize(buffer.size() * 2);
-    else
+  void watch(socket_type s, uint64_t until)
+  {
+    auto self = shared_from_this();
+    reactor::instance().watch(s, true, until, [self, s](bool ready) { self->on_event(s, ready); });
+  }
+
+  void on_event(socket_type s, bool ready)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (done)
     {
-      const char *cursor = reinterpret_cast<const char *>(buffer.data());
+      close_socket(s);
+      return;
+    }
 
-      while (written)
+    if (!ready)
+    {
+      if (clock_ms() < deadline)
       {
-        int result = send(_p->conn.impl()->socket, cursor, static_cast<int>(written), 0);
+        start_next();
+        watch(s, deadline);
+        return;
+      }
 
-        if (!result || result == detail::socket_error)
-          break;
+      // Overall deadline has passed, no further endpoints are tried
+      attempts.erase(std::find(attempts.begin(), attempts.end(), s));
+      close_socket(s);
+      finish(invalid_socket, lock);
+      return;
+    }
 
-        cursor += result;
-        written -= static_cast<size_t>(result);
-      }
+    int error = ready ? 0 : -1;
+    socklen_type errorLength = sizeof(error);
+
+    if (ready)
+      getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &errorLength);
+
+    attempts.erase(std::find(attempts.begin(), attempts.end(), s));
+
+    if (!error)
+    {
+      set_non_blocking(s, false);
+      finish(s, lock);
+      return;
     }
+
+    close_socket(s);
+
+    if (!start_next() && attempts.empty())
+      finish(invalid_socket, lock);
   }
 
-  kill_threads();
-  --_ap->threadCounter;
-}
+  void finish(socket_type s, std::unique_lock<std::mutex> &lock)
+  {
+    done = true;
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t async_tcp_client::async_write_handler(uint8_t *ptr, size_t length)
-{
-  HEADSOCKET_LOCK(_ap->writeBlocks);
- 
-  size_t toWrite = _ap->writeBlocks->peek(nullptr);
-  size_t toConsume = length > toWrite ? toWrite : length;
-  _ap->writeBlocks->read(ptr, toConsume);
+    for (auto attempt : attempts)
+      shutdown_socket(attempt);
 
-  if (toWrite == toConsume)
-    _ap->writeSemaphore.consume();
+    auto cb = std::move(callback);
+    lock.unlock();
+    cb(s);
+  }
+};
 
-  return toConsume;
-}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t async_tcp_client::async_read_handler(uint8_t *ptr, size_t length)
+struct resolver
 {
-  HEADSOCKET_LOCK(_ap->readBlocks);
+  struct entry
+  {
+    std::string address;
+    int port;
+    std::vector<endpoint> endpoints;
+    uint64_t expires;
+    bool used;
+  };
 
-  _ap->readBlocks->block_begin(opcode::binary);
-  _ap->readBlocks->write(ptr, length);
-  _ap->readBlocks->block_end();
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::unordered_map<std::string, entry> entries;
+  std::atomic<uint32_t> ttl = { 60000 };
+  std::atomic<uint32_t> negativeTtl = { 5000 };
+  bool quit = false;
+  std::unique_ptr<std::thread> thread;
 
-  return length;
-}
+  static resolver &instance()
+  {
+    static resolver result;
+    return result;
+  }
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::read_thread()
-{
-  ++_ap->threadCounter;
-  detail::set_thread_name("AsyncTcpClient::readThread");
+  resolver()
+  {
+    thread = std::make_unique<std::thread>([this]() { run(); });
+  }
 
-  std::vector<uint8_t> buffer(1024 * 1024);
-  size_t bufferBytes = 0, consumed = 0;
+  ~resolver()
+  {
+    {
+      HEADSOCKET_LOCK(mutex);
+      quit = true;
+    }
 
-  while (_p->isConnected)
+    cv.notify_one();
+    thread->join();
+  }
+
+  bool lookup(const std::string &address, int port, std::vector<endpoint> &result)
   {
-    while (true)
+    uint32_t positive = ttl;
+
+    if (!positive)
+      return resolve(address, port, result);
+
+    std::string key = address + ":" + std::to_string(port);
     {
-      int result = static_cast<int>(bufferBytes);
+      HEADSOCKET_LOCK(mutex);
+      auto iter = entries.find(key);
 
-      if (!result || !consumed)
+      if (iter != entries.end() && iter->second.expires > clock_ms())
       {
-        result = recv(
-          _p->conn.impl()->socket,
-          reinterpret_cast<char *>(buffer.data() + bufferBytes),
-          static_cast<int>(buffer.size() - bufferBytes),
-          0);
+        iter->second.used = true;
+        result = iter->second.endpoints;
+        return !result.empty();
+      }
+    }
+
+    bool resolved = resolve(address, port, result);
+    store(key, address, port, resolved ? result : std::vector<endpoint>(), resolved ? positive : negativeTtl.load());
+    return resolved;
+  }
+
+  void store(const std::string &key, const std::string &address, int port, std::vector<endpoint> endpoints,
+             uint32_t lifetime)
+  {
+    HEADSOCKET_LOCK(mutex);
+    entries[key] = { address, port, std::move(endpoints), clock_ms() + lifetime, false };
+  }
+
+  void run()
+  {
+    set_thread_name("Resolver");
+
+    std::vector<entry> refresh;
+    std::vector<endpoint> endpoints;
+
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(1), [this]() { return quit; });
+
+        if (quit)
+          break;
+
+        // Used entries are re-resolved during the last quarter of their lifetime, the rest is left to expire
+        uint64_t now = clock_ms();
+        uint64_t margin = ttl / 4;
+
+        for (auto iter = entries.begin(); iter != entries.end(); )
+        {
+          entry &e = iter->second;
+
+          if (e.expires <= now)
+            iter = entries.erase(iter);
+          else
+          {
+            if (e.used && !e.endpoints.empty() && e.expires - now <= margin)
+            {
+              e.used = false;
+              refresh.push_back(e);
+            }
+
+            ++iter;
+          }
+        }
+      }
+
+      // Failed refresh keeps the current entry until it expires
+      for (auto &e : refresh)
+        if (resolve(e.address, e.port, endpoints))
+          store(e.address + ":" + std::to_string(e.port), e.address, e.port, endpoints, ttl);
+
+      refresh.clear();
+    }
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void connect_async(const std::string &address, int port, const connect_options &options,
+                   std::function<void(socket_type)> callback)
+{
+  auto op = std::make_shared<connect_operation>();
+  op->deadline = clock_ms() + options.timeout;
+  op->attemptDelay = options.attempt_delay;
+  op->callback = std::move(callback);
+
+  if (!resolver::instance().lookup(address, port, op->endpoints))
+  {
+    op->callback(invalid_socket);
+    return;
+  }
+
+  op->start();
+}
+
+// Blocking variant with the same staggered attempts, bounded by options.timeout. Polls on the caller's thread and
+// never waits for the reactor, so it is safe in reactor callbacks and resumed coroutines.
+socket_type connect_sync(const std::string &address, int port, const connect_options &options)
+{
+  std::vector<endpoint> endpoints;
+
+  if (!resolver::instance().lookup(address, port, endpoints))
+    return invalid_socket;
+
+  uint64_t deadline = clock_ms() + options.timeout, nextAttempt = 0;
+  size_t next = 0;
+  std::vector<socket_type> attempts;
+  std::vector<pollfd_type> fds;
+  socket_type result = invalid_socket;
+
+  while (result == invalid_socket)
+  {
+    uint64_t now = clock_ms();
+
+    if (now >= deadline)
+      break;
+
+    // Next address is tried when nothing is pending or pending attempts take longer than attempt_delay
+    if (next < endpoints.size() && (attempts.empty() || now >= nextAttempt))
+    {
+      socket_type s = open_attempt(endpoints[next++]);
+
+      if (s != invalid_socket)
+      {
+        attempts.push_back(s);
+        nextAttempt = now + options.attempt_delay;
+      }
+
+      continue;
+    }
+
+    if (attempts.empty())
+      break;
+
+    fds.resize(attempts.size());
+    for (size_t i = 0; i < attempts.size(); ++i)
+    {
+      fds[i] = { };
+      fds[i].fd = attempts[i];
+      fds[i].events = POLLOUT;
+    }
+
+    uint64_t wake = next < endpoints.size() && nextAttempt < deadline ? nextAttempt : deadline;
+
+    if (poll_sockets(fds.data(), fds.size(), static_cast<int>(wake > now ? wake - now : 0)) <= 0)
+      continue;
+
+    for (size_t i = attempts.size(); i-- > 0; )
+    {
+      if (!fds[i].revents)
+        continue;
+
+      int error = 0;
+      socklen_type errorLength = sizeof(error);
+      getsockopt(attempts[i], SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &errorLength);
+
+      if (!error && result == invalid_socket)
+        result = attempts[i];
+      else
+        close_socket(attempts[i]);
+
+      attempts.erase(attempts.begin() + i);
+    }
+  }
+
+  for (auto s : attempts)
+    close_socket(s);
+
+  if (result != invalid_socket)
+    set_non_blocking(result, false);
+
+  return result;
+}
+
+} // namespace detail;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+  
+struct connection_impl
+{
+  detail::socket_type socket = detail::invalid_socket;
+  sockaddr_in from;
+  size_t id = 0;
+
+  void assign(const connection_impl &impl)
+  {
+    socket = impl.socket;
+    from = impl.from;
+    id = impl.id;
+  }
+
+  void close()
+  {
+    if (socket != detail::invalid_socket)
+    {
+      detail::close_socket(socket);
+      socket = detail::invalid_socket;
+    }
+  }
+};
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+connection::connection(const detail::connection_impl &impl)
+  : _p(std::make_unique<detail::connection_impl>())
+{
+  _p->assign(impl);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+connection::~connection()
+{
+  
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool connection::is_valid() const { return _p->socket != detail::invalid_socket; }
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t connection::id() const { return _p->id; }
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t connection::write(const void *ptr, size_t length)
+{
+  if (!is_valid())
+    return detail::socket_error;
+
+  if (!ptr || !length)
+    return 0;
+
+  int result = detail::send_blocking(_p->socket, static_cast<const char *>(ptr), static_cast<int>(length));
+
+  if (!result || result == detail::socket_error)
+    return 0;
+
+  return static_cast<size_t>(result);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool connection::force_write(const void *ptr, size_t length)
+{
+  if (!is_valid())
+    return false;
+
+  if (!ptr)
+    return true;
+
+  const char *chPtr = static_cast<const char *>(ptr);
+
+  while (length)
+  {
+    int result = detail::send_blocking(_p->socket, chPtr, static_cast<int>(length));
+
+    if (!result || result == detail::socket_error)
+      return false;
+
+    length -= static_cast<size_t>(result);
+    chPtr += result;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool connection::force_writev(const io_buffer *buffers, size_t count)
+{
+  if (!is_valid())
+    return false;
+
+  const size_t maxBatch = 16;
+
+  while (count)
+  {
+    size_t batch = count < maxBatch ? count : maxBatch, batchLength = 0, written = 0;
+
+#if defined(HEADSOCKET_PLATFORM_WINDOWS)
+    WSABUF vec[maxBatch];
+    for (size_t i = 0; i < batch; ++i)
+    {
+      vec[i].buf = static_cast<CHAR *>(const_cast<void *>(buffers[i].ptr));
+      vec[i].len = static_cast<ULONG>(buffers[i].length);
+      batchLength += buffers[i].length;
+    }
+
+    DWORD sent = 0;
+    if (batchLength && WSASend(_p->socket, vec, static_cast<DWORD>(batch), &sent, 0, nullptr, nullptr) == detail::socket_error)
+    {
+      if (!detail::would_block())
+        return false;
+
+      detail::poll_socket(_p->socket, true, -1);
+      continue;
+    }
+
+    written = static_cast<size_t>(sent);
+#else
+    iovec vec[maxBatch];
+    for (size_t i = 0; i < batch; ++i)
+    {
+      vec[i].iov_base = const_cast<void *>(buffers[i].ptr);
+      vec[i].iov_len = buffers[i].length;
+      batchLength += buffers[i].length;
+    }
+
+    ssize_t result = batchLength ? writev(_p->socket, vec, static_cast<int>(batch)) : 0;
+    if (result < 0)
+    {
+      if (!detail::would_block())
+        return false;
+
+      detail::poll_socket(_p->socket, true, -1);
+      continue;
+    }
+
+    written = static_cast<size_t>(result);
+#endif
+
+    if (!written && batchLength)
+      return false;
+
+    while (count && written >= buffers->length)
+    {
+      written -= buffers->length;
+      ++buffers;
+      --count;
+    }
+
+    // Short write, finish the partially sent buffer before gathering the rest
+    if (written)
+    {
+      if (!force_write(static_cast<const char *>(buffers->ptr) + written, buffers->length - written))
+        return false;
+
+      ++buffers;
+      --count;
+    }
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t connection::read(void *ptr, size_t length)
+{
+  if (!is_valid())
+    return detail::socket_error;
+
+  if (!ptr || !length)
+    return 0;
+
+  int result = detail::recv_blocking(_p->socket, static_cast<char *>(ptr), static_cast<int>(length));
+
+  if (!result || result == detail::socket_error)
+    return 0;
+
+  return static_cast<size_t>(result);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool connection::force_read(void *ptr, size_t length)
+{
+  if (!is_valid())
+    return false;
+
+  if (!ptr)
+    return true;
+
+  char *chPtr = static_cast<char *>(ptr);
+
+  while (length)
+  {
+    int result = detail::recv_blocking(_p->socket, chPtr, static_cast<int>(length));
+
+    if (!result || result == detail::socket_error)
+      return false;
+
+    length -= static_cast<size_t>(result);
+    chPtr += result;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool connection::read_line(std::string &output)
+{
+  if (!is_valid())
+    return false;
+
+  output = "";
+
+  while (true)
+  {
+    char ch;
+    int r = detail::recv_blocking(_p->socket, &ch, 1);
+
+    if (!r || r == detail::socket_error)
+      return false;
+
+    if (ch == '\n')
+      break;
+    else if (ch != '\r')
+      output += ch;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+struct basic_tcp_server_impl
+{
+  std::atomic_bool isRunning;
+  sockaddr_in local;
+  detail::lockable_value<basic_tcp_server::client_list> connections;
+  std::unordered_map<id_t, size_t> connectionIndex;
+  basic_tcp_server::client_snapshot clients = std::make_shared<basic_tcp_server::client_list>();
+  detail::blocking_queue<ptr<basic_tcp_client>> disconnected;
+  int port = 0;
+  detail::socket_type serverSocket = invalid_socket;
+  std::unique_ptr<std::thread> acceptThread;
+  std::unique_ptr<std::thread> disconnectThread;
+  id_t nextClientID = 1;
+
+  typedef std::vector<std::shared_ptr<detail::shard>> shard_list;
+  std::shared_ptr<const shard_list> shards = std::make_shared<shard_list>();
+  size_t nextShard = 0;
+
+  // Shards are fixed once accept thread takes its first client, client timers must not be dropped
+  std::mutex shardsMutex;
+  bool accepting = false;
+
+  std::atomic<uint32_t> handshakeTimeout;
+  std::atomic<uint32_t> idleTimeout;
+  std::atomic<uint32_t> pingInterval;
+  std::atomic_bool noDelay;
+  std::atomic<uint32_t> coalesceDelay;
+
+  static const size_t max_shards = 256;
+
+  basic_tcp_server_impl()
+  {
+    isRunning = false;
+    handshakeTimeout = 0;
+    idleTimeout = 0;
+    pingInterval = 0;
+    noDelay = true;
+    coalesceDelay = 0;
+  }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_server::basic_tcp_server(int port)
+  : _p(std::make_unique<detail::basic_tcp_server_impl>())
+{
+#ifdef HEADSOCKET_PLATFORM_WINDOWS
+  WSADATA wsaData;
+  WSAStartup(0x101, &wsaData);
+#endif
+
+  _p->local.sin_family = AF_INET;
+  _p->local.sin_addr.s_addr = INADDR_ANY;
+  _p->local.sin_port = htons(static_cast<unsigned short>(port));
+
+  _p->serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (bind(_p->serverSocket, reinterpret_cast<sockaddr *>(&_p->local), sizeof(_p->local)) != 0)
+    return;
+
+  if (listen(_p->serverSocket, 8))
+    return;
+
+  _p->isRunning = true;
+  _p->port = port;
+  set_shards(1, false);
+  _p->acceptThread = std::make_unique<std::thread>(std::bind(&basic_tcp_server::accept_thread, this));
+  _p->disconnectThread = std::make_unique<std::thread>(std::bind(&basic_tcp_server::disconnect_thread, this));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_server::~basic_tcp_server()
+{
+  stop();
+
+#ifdef HEADSOCKET_PLATFORM_WINDOWS
+  WSACleanup();
+#endif
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int basic_tcp_server::port() const { return _p->port; }
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::stop()
+{
+  if (_p->isRunning.exchange(false))
+  {
+    detail::close_socket(_p->serverSocket);
+
+    for (auto &client : *snapshot_clients())
+      client->disconnect();
+
+    if (_p->acceptThread)
+    {
+      _p->acceptThread->join();
+      _p->acceptThread = nullptr;
+    }
+
+    if (_p->disconnectThread)
+    {
+      _p->disconnected.close();
+
+      _p->disconnectThread->join();
+      _p->disconnectThread = nullptr;
+    }
+
+    for (auto &s : *std::atomic_load(&_p->shards))
+      s->stop();
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_server::is_running() const { return _p->isRunning; }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_server::disconnect(ptr<basic_tcp_client> client)
+{
+  bool found = false;
+
+  if (client)
+  {
+    found = find_client(client->id()) == client;
+
+    if (found && !client->disconnect())
+    {
+      client_disconnected(client);
+      enqueue_disconnected(client);
+    }
+  }
+
+  return found;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_server::disconnect(id_t id)
+{
+  bool found = false;
+
+  if (id)
+  {
+    ptr<basic_tcp_client> client = find_client(id);
+    found = client != nullptr;
+
+    if (found && !client->disconnect())
+    {
+      client_disconnected(client);
+      enqueue_disconnected(client);
+    }
+  }
+
+  return found;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::set_timeouts(const timeouts &t)
+{
+  _p->handshakeTimeout = t.handshake;
+  _p->idleTimeout = t.idle;
+  _p->pingInterval = t.ping_interval;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_server::timeouts basic_tcp_server::get_timeouts() const
+{
+  timeouts result;
+  result.handshake = _p->handshakeTimeout;
+  result.idle = _p->idleTimeout;
+  result.ping_interval = _p->pingInterval;
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::set_write_profile(const write_profile &profile)
+{
+  _p->noDelay = profile.no_delay;
+  _p->coalesceDelay = profile.max_coalesce_delay;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+write_profile basic_tcp_server::get_write_profile() const
+{
+  write_profile result;
+  result.no_delay = _p->noDelay;
+  result.max_coalesce_delay = _p->coalesceDelay;
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_server::set_shards(size_t count, bool pinToCores)
+{
+  HEADSOCKET_LOCK(_p->shardsMutex);
+
+  if (!_p->isRunning || _p->accepting)
+    return false;
+
+  count = count < 1 ? 1 : (count > detail::basic_tcp_server_impl::max_shards ? detail::basic_tcp_server_impl::max_shards : count);
+
+  auto shards = std::make_shared<detail::basic_tcp_server_impl::shard_list>();
+  size_t numCores = std::thread::hardware_concurrency();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    shards->push_back(std::make_shared<detail::shard>());
+    shards->back()->start(pinToCores && numCores ? static_cast<int>(i % numCores) : -1);
+  }
+
+  auto previous = std::atomic_exchange(&_p->shards, std::shared_ptr<const detail::basic_tcp_server_impl::shard_list>(shards));
+
+  for (auto &s : *previous)
+    s->stop();
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t basic_tcp_server::num_shards() const { return std::atomic_load(&_p->shards)->size(); }
+
+//---------------------------------------------------------------------------------------------------------------------
+std::shared_ptr<detail::shard> basic_tcp_server::shard_at(size_t index) const
+{
+  auto shards = std::atomic_load(&_p->shards);
+  return shards->empty() ? nullptr : (*shards)[index % shards->size()];
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::post(size_t shard, std::function<void()> work)
+{
+  if (auto s = shard_at(shard))
+    s->post(std::move(work));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::post(ptr<basic_tcp_client> client, std::function<void()> work)
+{
+  if (client)
+    post(client->shard(), std::move(work));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+timer_id basic_tcp_server::add_timer(size_t shard, uint32_t milliseconds, std::function<void()> callback)
+{
+  auto s = shard_at(shard);
+  if (!s)
+    return 0;
+
+  shard %= num_shards();
+
+  HEADSOCKET_LOCK(s->timers);
+  return (static_cast<timer_id>(shard) << 56) | s->timers->schedule(milliseconds, std::move(callback));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_server::cancel_timer(timer_id id)
+{
+  auto s = shard_at(static_cast<size_t>(id >> 56));
+  if (!s)
+    return false;
+
+  HEADSOCKET_LOCK(s->timers);
+  return s->timers->cancel(id & ((1ULL << 56) - 1));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::arm_idle_timer(std::weak_ptr<basic_tcp_client> client, uint32_t delay)
+{
+  auto owner = client.lock();
+  if (!owner)
+    return;
+
+  add_timer(owner->shard(), delay, [this, client]()
+  {
+    auto c = client.lock();
+    uint32_t timeout = _p->idleTimeout;
+
+    if (!c || !c->is_connected() || !timeout)
+      return;
+
+    uint64_t idle = detail::clock_ms() - c->last_activity();
+
+    if (idle >= timeout)
+      disconnect(c);
+    else
+      arm_idle_timer(client, static_cast<uint32_t>(timeout - idle));
+  });
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::arm_ping_timer(std::weak_ptr<basic_tcp_client> client, uint32_t delay)
+{
+  auto owner = client.lock();
+  if (!owner)
+    return;
+
+  add_timer(owner->shard(), delay, [this, client]()
+  {
+    auto c = client.lock();
+    uint32_t interval = _p->pingInterval;
+
+    if (!c || !c->is_connected() || !interval)
+      return;
+
+    c->on_keepalive();
+    arm_ping_timer(client, interval);
+  });
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_server::client_snapshot basic_tcp_server::snapshot_clients() const { return std::atomic_load(&_p->clients); }
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::publish_clients() const
+{
+  std::atomic_store(&_p->clients, std::make_shared<const client_list>(_p->connections.value));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::enqueue_disconnected(ptr<basic_tcp_client> client) { _p->disconnected.push(client); }
+
+//---------------------------------------------------------------------------------------------------------------------
+ptr<basic_tcp_client> basic_tcp_server::find_client(id_t id) const
+{
+  HEADSOCKET_LOCK(_p->connections);
+
+  auto iter = _p->connectionIndex.find(id);
+  return iter != _p->connectionIndex.end() ? _p->connections.value[iter->second] : nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::accept_thread()
+{
+  detail::set_thread_name("BaseTcpServer::acceptThread");
+
+  while (_p->isRunning)
+  {
+    detail::connection_impl conn_impl;
+    conn_impl.socket = ::accept(_p->serverSocket, reinterpret_cast<struct sockaddr *>(&conn_impl.from), nullptr);
+    conn_impl.id = _p->nextClientID++;
+
+    if (!_p->nextClientID)
+      ++_p->nextClientID;
+
+    if (!_p->isRunning)
+      break;
+
+    if (conn_impl.socket != detail::invalid_socket)
+    {
+      if (!_p->accepting)
+      {
+        HEADSOCKET_LOCK(_p->shardsMutex);
+        _p->accepting = true;
+      }
+
+      connection conn(conn_impl);
+
+      ptr<basic_tcp_client> newClient;
+      bool failed = false;
+      size_t shard = _p->nextShard++;
+
+      std::shared_ptr<std::atomic_int> deadlineState;
+      timer_id deadline = 0;
+
+      if (uint32_t timeout = _p->handshakeTimeout)
+      {
+        auto state = deadlineState = std::make_shared<std::atomic_int>(0);
+        auto socket = conn_impl.socket;
+
+        // Unblocks handshake by shutting the socket down, closing it is left to this thread. Does nothing once
+        // the handshake has claimed the state.
+        deadline = add_timer(shard, timeout, [state, socket]()
+        {
+          int expected = 0;
+          if (!state->compare_exchange_strong(expected, 1))
+            return;
+
+          detail::shutdown_socket(socket);
+          *state = 2;
+        });
+      }
+
+      bool handshakeDone = handshake(conn);
+
+      // Claiming the state keeps a late (or dropped) timer from ever touching the socket, otherwise the timer is
+      // already shutting it down and only has to finish
+      if (deadline)
+      {
+        int expected = 0;
+
+        if (deadlineState->compare_exchange_strong(expected, 3))
+          cancel_timer(deadline);
+        else
+        {
+          while (*deadlineState != 2)
+            std::this_thread::yield();
+
+          handshakeDone = false;
+        }
+      }
+
+      if (handshakeDone)
+      {
+        if (newClient = accept(conn))
+        {
+          newClient->set_write_profile(get_write_profile());
+          newClient->attach(newClient, shard % num_shards());
+          newClient->touch();
+          newClient->on_accept();
+
+          {
+            HEADSOCKET_LOCK(_p->connections);
+            _p->connectionIndex[newClient->id()] = _p->connections->size();
+            _p->connections->push_back(newClient);
+            publish_clients();
+          }
+
+          // Client could have dropped before it was registered, nobody would reclaim it then
+          if (!newClient->is_connected())
+            enqueue_disconnected(newClient);
+
+          if (uint32_t timeout = _p->idleTimeout)
+            arm_idle_timer(newClient, timeout);
+
+          if (uint32_t interval = _p->pingInterval)
+            arm_ping_timer(newClient, interval);
+        }
+        else
+          failed = true;
+      }
+      else
+        failed = true;
+
+      if (failed)
+      {
+        conn_impl.close();
+        --_p->nextClientID;
+
+        if (!_p->nextClientID)
+          --_p->nextClientID;
+      }
+      else
+        client_connected(newClient);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_server::disconnect_thread()
+{
+  detail::set_thread_name("BaseTcpServer::disconnectThread");
+
+  std::vector<ptr<basic_tcp_client>> batch, removed;
+
+  while (_p->disconnected.drain(batch))
+  {
+    {
+      HEADSOCKET_LOCK(_p->connections);
+
+      for (auto &client : batch)
+      {
+        auto iter = _p->connectionIndex.find(client->id());
+
+        // Already reclaimed, clients can be queued more than once
+        if (iter == _p->connectionIndex.end() || _p->connections.value[iter->second] != client)
+          continue;
+
+        size_t index = iter->second;
+        _p->connectionIndex.erase(iter);
+
+        if (index + 1 != _p->connections->size())
+        {
+          _p->connections.value[index] = std::move(_p->connections->back());
+          _p->connectionIndex[_p->connections.value[index]->id()] = index;
+        }
+
+        _p->connections->pop_back();
+        removed.push_back(client);
+      }
+
+      if (!removed.empty())
+        publish_clients();
+    }
+
+    for (auto &client : removed)
+      client->on_disconnect();
+
+    removed.clear();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+struct basic_tcp_client_impl
+{
+  std::atomic_int refCount;
+  std::atomic_bool isConnected;
+  std::atomic<uint64_t> lastActivity;
+  std::atomic<uint32_t> coalesceDelay;
+  std::atomic_bool nonBlocking = { false };
+  size_t shard = 0;
+  std::shared_ptr<detail::strand> strand = std::make_shared<detail::strand>();
+  std::weak_ptr<basic_tcp_client> self;
+  std::weak_ptr<basic_tcp_server> server;
+  connection conn = detail::connection_impl();
+  std::string address = "";
+  int port = 0;
+
+  basic_tcp_client_impl()
+  {
+    refCount = 0;
+    isConnected = false;
+    lastActivity = 0;
+    coalesceDelay = 0;
+  }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+void resolver_cache::set_ttl(uint32_t ttl, uint32_t negativeTtl)
+{
+  detail::resolver::instance().ttl = ttl;
+  detail::resolver::instance().negativeTtl = negativeTtl;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void resolver_cache::clear()
+{
+  auto &r = detail::resolver::instance();
+  HEADSOCKET_LOCK(r.mutex);
+  r.entries.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_client::basic_tcp_client(const std::string &address, int port)
+  : _p(std::make_unique<detail::basic_tcp_client_impl>())
+{
+  _p->conn.impl()->socket = detail::connect_sync(address, port, connect_options());
+
+  if (!_p->conn.is_valid())
+    return;
+
+  _p->address = address;
+  _p->port = port;
+  _p->isConnected = true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_client::basic_tcp_client(ptr<basic_tcp_server> server, connection &conn)
+  : _p(std::make_unique<detail::basic_tcp_client_impl>())
+{
+  _p->server = server;
+  _p->conn.impl()->assign(*(conn.impl()));
+  _p->isConnected = true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::connect_socket(const std::string &address, int port, const connect_options &options,
+                                      std::function<void(connection *)> callback)
+{
+  detail::connect_async(address, port, options, [callback](detail::socket_type s)
+  {
+    // Client construction, on_connect and user callback may take a while, reactor keeps polling meanwhile
+    detail::executor::instance().post([callback, s]()
+    {
+      if (s == detail::invalid_socket)
+      {
+        callback(nullptr);
+        return;
+      }
+
+      detail::connection_impl impl;
+      impl.socket = s;
+      connection conn(impl);
+      callback(&conn);
+    });
+  });
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::start_outbound(std::weak_ptr<basic_tcp_client> self)
+{
+  _p->self = self;
+  on_connect();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_tcp_client::~basic_tcp_client()
+{
+  disconnect();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_client::disconnect()
+{
+  bool wasConnected = _p->isConnected.exchange(false);
+
+  if (wasConnected)
+  {
+    _p->conn.impl()->close();
+
+    ptr<basic_tcp_server> s = server();
+
+    if (s)
+      s->disconnect(_p->conn.id());
+  }
+
+  return wasConnected;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_client::is_connected() const { return _p->isConnected; }
+
+//---------------------------------------------------------------------------------------------------------------------
+uint64_t basic_tcp_client::last_activity() const { return _p->lastActivity; }
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::set_write_profile(const write_profile &profile)
+{
+  if (_p->conn.is_valid())
+    detail::set_no_delay(_p->conn.impl()->socket, profile.no_delay);
+
+  _p->coalesceDelay = profile.max_coalesce_delay;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t basic_tcp_client::shard() const { return _p->shard; }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_client::probe()
+{
+  if (!_p->isConnected)
+    return false;
+
+  if (detail::poll_socket(_p->conn.impl()->socket, false, 0))
+  {
+    disconnect();
+    return false;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::attach(std::weak_ptr<basic_tcp_client> self, size_t shard)
+{
+  _p->self = self;
+  _p->shard = shard;
+
+  // Scheduled strand stays pending until its work runs, so work refused by a stopped server must not be dropped
+  std::weak_ptr<basic_tcp_server> server = _p->server;
+  _p->strand->dispatch = [server, shard](std::function<void()> work)
+  {
+    auto s = server.lock();
+    auto target = s ? s->shard_at(shard) : nullptr;
+
+    if (!target || !target->post(std::move(work)))
+      detail::executor::instance().post(std::move(work));
+  };
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::post(std::function<void()> work) { _p->strand->post(std::move(work)); }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool basic_tcp_client::running_in_strand() const { return _p->strand->runner == std::this_thread::get_id(); }
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_tcp_client::touch() { _p->lastActivity = detail::clock_ms(); }
+
+//---------------------------------------------------------------------------------------------------------------------
+ptr<basic_tcp_server> basic_tcp_client::server() const { return _p->server.lock(); }
+
+//---------------------------------------------------------------------------------------------------------------------
+id_t basic_tcp_client::id() const { return _p->conn.id(); }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::tcp_client(const std::string &address, int port)
+  : base_t(address, port)
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::tcp_client(ptr<basic_tcp_server> server, connection &conn)
+  : base_t(server, conn)
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::~tcp_client()
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t tcp_client::write(const void *ptr, size_t length) { return _p->conn.write(ptr, length); }
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t tcp_client::read(void *ptr, size_t length)
+{
+  size_t result = _p->conn.read(ptr, length);
+
+  if (result && result != invalid_operation)
+    touch();
+
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool tcp_client::force_write(const void *ptr, size_t length) { return _p->conn.force_write(ptr, length); }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool tcp_client::force_read(void *ptr, size_t length)
+{
+  bool result = _p->conn.force_read(ptr, length);
+
+  if (result)
+    touch();
+
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool tcp_client::read_line(std::string &output)
+{
+  bool result = _p->conn.read_line(output);
+
+  if (result)
+    touch();
+
+  return result;
+}
+
+#ifdef HEADSOCKET_COROUTINES
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::io_operation tcp_client::read_some(void *ptr, size_t length)
+{
+  return io_operation(this, reinterpret_cast<uint8_t *>(ptr), length, false, false);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::io_operation tcp_client::read_all(void *ptr, size_t length)
+{
+  return io_operation(this, reinterpret_cast<uint8_t *>(ptr), length, false, true);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+tcp_client::io_operation tcp_client::write_all(const void *ptr, size_t length)
+{
+  return io_operation(this, reinterpret_cast<uint8_t *>(const_cast<void *>(ptr)), length, true, true);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool tcp_client::io_step(io_operation &op)
+{
+  detail::socket_type s = _p->conn.impl()->socket;
+
+  while (op._done < op._length)
+  {
+    if (!_p->isConnected)
+    {
+      op._result = invalid_operation;
+      return true;
+    }
+
+    if (!detail::poll_socket(s, op._write, 0))
+      return false;
+
+    // Readiness does not mean the whole buffer fits, so the transfer must not block the reactor thread. Without
+    // MSG_DONTWAIT (Windows) the socket is switched to non-blocking mode for good, synchronous calls on it wait for
+    // readiness themselves.
+    if (!HEADSOCKET_MSG_DONTWAIT && !_p->nonBlocking.exchange(true))
+      detail::set_non_blocking(s, true);
+
+    int toTransfer = static_cast<int>(op._length - op._done);
+    int result = op._write
+      ? send(s, reinterpret_cast<const char *>(op._ptr + op._done), toTransfer, HEADSOCKET_MSG_DONTWAIT)
+      : recv(s, reinterpret_cast<char *>(op._ptr + op._done), toTransfer, HEADSOCKET_MSG_DONTWAIT);
+
+    if (result == detail::socket_error && detail::would_block())
+      return false;
+
+    if (!result || result == detail::socket_error)
+    {
+      op._result = invalid_operation;
+      return true;
+    }
+
+    op._done += static_cast<size_t>(result);
+
+    if (!op._write)
+      touch();
+
+    if (!op._all)
+      break;
+  }
+
+  op._result = op._done;
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void tcp_client::io_suspend(io_operation &op, std::function<void()> resume)
+{
+  detail::reactor::instance().watch(_p->conn.impl()->socket, op._write, 0, [this, &op, resume](bool)
+  {
+    if (!io_step(op))
+      io_suspend(op, resume);
+    else if (_p->strand->dispatch)
+      post(resume);
+    else
+      detail::executor::instance().post([this, resume]() { post(resume); });
+  });
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+struct basic_connection_pool_impl
+{
+  struct idle_client
+  {
+    ptr<basic_tcp_client> client;
+    uint64_t since;
+  };
+
+  // Woken waiter either gets a connection handed over, or a permit to open its own
+  struct waiter
+  {
+    ptr<basic_tcp_client> client;
+    bool ready = false;
+  };
+
+  struct endpoint_pool
+  {
+    std::vector<idle_client> idle;
+    std::deque<waiter *> waiters;
+    size_t total = 0;
+  };
+
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  std::unordered_map<std::string, endpoint_pool> endpoints;
+  basic_connection_pool::limits limits;
+
+  static std::string key(const std::string &address, int port) { return address + ":" + std::to_string(port); }
+
+  // Caller holds the lock. Most recently used connection is taken first, it is the least likely to be dropped by peer.
+  ptr<basic_tcp_client> take_idle(endpoint_pool &ep)
+  {
+    uint64_t now = clock_ms();
+
+    while (!ep.idle.empty())
+    {
+      idle_client entry = std::move(ep.idle.back());
+      ep.idle.pop_back();
+
+      if (now - entry.since <= limits.max_idle_time && entry.client->probe())
+        return entry.client;
+
+      entry.client->disconnect();
+      --ep.total;
+    }
+
+    return nullptr;
+  }
+
+  // Caller holds the lock, connection slot of a dropped connection goes to the first waiter
+  void drop_slot(endpoint_pool &ep)
+  {
+    if (ep.waiters.empty())
+    {
+      --ep.total;
+      return;
+    }
+
+    ep.waiters.front()->ready = true;
+    ep.waiters.pop_front();
+    cv.notify_all();
+  }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_connection_pool::basic_connection_pool()
+  : _p(std::make_unique<detail::basic_connection_pool_impl>())
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_connection_pool::~basic_connection_pool()
+{
+  clear();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_connection_pool::set_limits(const limits &l)
+{
+  HEADSOCKET_LOCK(_p->mutex);
+  _p->limits = l;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+basic_connection_pool::limits basic_connection_pool::get_limits() const
+{
+  HEADSOCKET_LOCK(_p->mutex);
+  return _p->limits;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t basic_connection_pool::num_idle() const
+{
+  HEADSOCKET_LOCK(_p->mutex);
+
+  size_t result = 0;
+  for (auto &kvp : _p->endpoints)
+    result += kvp.second.idle.size();
+
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_connection_pool::clear()
+{
+  HEADSOCKET_LOCK(_p->mutex);
+
+  for (auto &kvp : _p->endpoints)
+  {
+    for (auto &entry : kvp.second.idle)
+    {
+      entry.client->disconnect();
+      --kvp.second.total;
+    }
+
+    kvp.second.idle.clear();
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+ptr<basic_tcp_client> basic_connection_pool::acquire_client(const std::string &address, int port, uint32_t timeout,
+                                                            const factory_t &factory)
+{
+  std::unique_lock<std::mutex> lock(_p->mutex);
+  auto &ep = _p->endpoints[detail::basic_connection_pool_impl::key(address, port)];
+
+  // Nobody may overtake waiting callers
+  if (ep.waiters.empty())
+  {
+    if (auto client = _p->take_idle(ep))
+      return client;
+
+    if (ep.total < _p->limits.max_total)
+    {
+      ++ep.total;
+      lock.unlock();
+      return connect_client(address, port, factory);
+    }
+  }
+
+  detail::basic_connection_pool_impl::waiter w;
+  ep.waiters.push_back(&w);
+
+  if (!_p->cv.wait_for(lock, std::chrono::milliseconds(timeout), [&w]() { return w.ready; }))
+  {
+    ep.waiters.erase(std::find(ep.waiters.begin(), ep.waiters.end(), &w));
+    return nullptr;
+  }
+
+  if (w.client)
+    return w.client;
+
+  lock.unlock();
+  return connect_client(address, port, factory);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+ptr<basic_tcp_client> basic_connection_pool::connect_client(const std::string &address, int port, const factory_t &factory)
+{
+  ptr<basic_tcp_client> client = factory(address, port);
+
+  if (client && client->is_connected())
+    return client;
+
+  HEADSOCKET_LOCK(_p->mutex);
+  _p->drop_slot(_p->endpoints[detail::basic_connection_pool_impl::key(address, port)]);
+  return nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void basic_connection_pool::release_client(const std::string &address, int port, ptr<basic_tcp_client> client)
+{
+  HEADSOCKET_LOCK(_p->mutex);
+  auto &ep = _p->endpoints[detail::basic_connection_pool_impl::key(address, port)];
+
+  if (client->is_connected())
+  {
+    if (!ep.waiters.empty())
+    {
+      ep.waiters.front()->client = client;
+      ep.waiters.front()->ready = true;
+      ep.waiters.pop_front();
+      _p->cv.notify_all();
+      return;
+    }
+
+    if (ep.idle.size() < _p->limits.max_idle)
+    {
+      ep.idle.push_back({ client, detail::clock_ms() });
+      return;
+    }
+
+    client->disconnect();
+  }
+
+  _p->drop_slot(ep);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t length_prefix_framer::read_message(const uint8_t *ptr, size_t length, size_t &payloadOffset, size_t &payloadLength)
+{
+  uint64_t value = 0;
+
+  if (_type == prefix::u32)
+  {
+    if (length < 4)
+      return 0;
+
+    value = (static_cast<uint32_t>(ptr[0]) << 24) | (static_cast<uint32_t>(ptr[1]) << 16) |
+            (static_cast<uint32_t>(ptr[2]) << 8) | static_cast<uint32_t>(ptr[3]);
+    payloadOffset = 4;
+  }
+  else
+  {
+    size_t i = 0;
+
+    for (; i < length && i < 10; ++i)
+    {
+      value |= static_cast<uint64_t>(ptr[i] & 0x7F) << (7 * i);
+
+      if (!(ptr[i] & 0x80))
+        break;
+    }
+
+    if (i == 10)
+      return basic_tcp_client::invalid_operation;
+    else if (i == length)
+      return 0;
+
+    payloadOffset = i + 1;
+  }
+
+  if (value > _max_message_size)
+    return basic_tcp_client::invalid_operation;
+
+  payloadLength = static_cast<size_t>(value);
+  return length - payloadOffset >= payloadLength ? payloadOffset + payloadLength : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t length_prefix_framer::write_header(uint8_t *ptr, size_t payloadLength) const
+{
+  // Peer would refuse it anyway, truncated u32 prefix would even desync its reader
+  if (payloadLength > _max_message_size || (_type == prefix::u32 && static_cast<uint64_t>(payloadLength) > 0xFFFFFFFFull))
+    return basic_tcp_client::invalid_operation;
+
+  if (_type == prefix::u32)
+  {
+    uint32_t value = static_cast<uint32_t>(payloadLength);
+    ptr[0] = static_cast<uint8_t>(value >> 24);
+    ptr[1] = static_cast<uint8_t>(value >> 16);
+    ptr[2] = static_cast<uint8_t>(value >> 8);
+    ptr[3] = static_cast<uint8_t>(value);
+    return 4;
+  }
+
+  uint64_t value = payloadLength;
+  size_t result = 0;
+
+  do
+  {
+    ptr[result++] = static_cast<uint8_t>((value & 0x7F) | (value > 0x7F ? 0x80 : 0x00));
+    value >>= 7;
+  }
+  while (value);
+
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t delimiter_framer::read_message(const uint8_t *ptr, size_t length, size_t &payloadOffset, size_t &payloadLength)
+{
+  // Data are only ever appended between unsuccessful calls, no need to scan the same bytes again
+  size_t from = _scanned < length ? _scanned : 0;
+  auto found = static_cast<const uint8_t *>(memchr(ptr + from, _delimiter, length - from));
+
+  if (!found)
+  {
+    if (length > _max_message_size)
+      return basic_tcp_client::invalid_operation;
+
+    _scanned = length;
+    return 0;
+  }
+
+  _scanned = 0;
+  payloadOffset = 0;
+  payloadLength = found - ptr;
+  return payloadLength + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+struct async_tcp_client_impl
+{
+  detail::semaphore writeSemaphore;
+  detail::lockable_value<detail::data_block_buffer> writeBlocks;
+  detail::data_block_buffer readBlocks;
+  std::unique_ptr<std::thread> writeThread;
+  std::unique_ptr<std::thread> readThread;
+  std::atomic_int threadCounter = { 0 };
+
+  std::mutex messageMutex;
+  std::vector<uint8_t> streamChunk;
+  opcode streamOpcode = opcode::binary;
+  bool streamFirst = false;
+
+  std::mutex drainMutex;
+  std::condition_variable drained;
+  std::atomic_int drainWaiters = { 0 };
+
+  // Suspended sends, each resumed once the queue drains below its own limit
+  struct drain_waiter
+  {
+    size_t limit;
+    std::function<void()> resume;
+  };
+
+  std::vector<drain_waiter> asyncDrainWaiters;
+
+  // Completed messages, written only by read thread and read only by the consumer
+  detail::spsc_queue<detail::inbound_message> inbound;
+  size_t inboundOffset = 0;
+
+  std::mutex readyMutex;
+  std::condition_variable readyCv;
+  std::function<void()> readWaiter;
+  std::function<void()> dataNotification;
+  std::atomic_bool readWaiting = { false };
+  std::atomic_bool hasDataNotification = { false };
+  std::atomic_int readySleepers = { 0 };
+
+  // Read thread only, set when messages were queued since the last notification
+  bool published = false;
+
+  // Large buffers are not kept around in recycled queue nodes
+  static const size_t max_cached_message = 64 * 1024;
+
+  void publish(opcode op, const uint8_t *ptr, size_t length)
+  {
+    inbound_message &msg = inbound.prepare();
+
+    if (msg.data.capacity() > max_cached_message && length <= max_cached_message)
+      std::vector<uint8_t>().swap(msg.data);
+
+    msg.op = op;
+    msg.data.assign(ptr, ptr + length);
+    inbound.publish();
+    published = true;
+  }
+
+  std::atomic_bool closing = { false };
+  std::atomic_bool disconnectAfterFlush = { false };
+  std::atomic_bool strandDelivery = { false };
+
+  std::unique_ptr<message_framer> framer;
+
+  // Caller holds writeBlocks lock and has begun a block, the block is removed when framer refuses the message
+  bool write_framed(const void *ptr, size_t length, bool header, bool trailer)
+  {
+    uint8_t framing[message_framer::max_framing_size];
+
+    if (framer && header)
+    {
+      size_t headerSize = framer->write_header(framing, length);
+
+      if (headerSize == basic_tcp_client::invalid_operation)
+      {
+        writeBlocks->block_remove();
+        return false;
+      }
+
+      writeBlocks->write(framing, headerSize);
+    }
+
+    writeBlocks->write(ptr, length);
+
+    if (framer && trailer)
+      writeBlocks->write(framing, framer->write_trailer(framing));
+
+    return true;
+  }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::async_tcp_client(const std::string &address, int port)
+  : base_t(address, port)
+  , _ap(std::make_unique<detail::async_tcp_client_impl>())
+{
+  
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::async_tcp_client(ptr<basic_tcp_server> server, connection &conn)
+  : base_t(server, conn)
+  , _ap(new detail::async_tcp_client_impl())
+{
+  
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::~async_tcp_client()
+{
+  disconnect();
+
+  _ap->writeSemaphore.notify();
+  _ap->writeThread->join();
+  _ap->readThread->join();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::push(const void *ptr, size_t length, opcode opcode)
+{
+  if (!ptr)
+    return;
+
+  // Control frames may be interleaved with a streamed message, data frames must wait for it to finish
+  std::unique_lock<std::mutex> messageLock(_ap->messageMutex, std::defer_lock);
+
+  if (opcode == opcode::text || opcode == opcode::binary)
+    messageLock.lock();
+
+  {
+    HEADSOCKET_LOCK(_ap->writeBlocks);
+    _ap->writeBlocks->block_begin(opcode);
+
+    if (!_ap->write_framed(ptr, length, true, true))
+      return;
+
+    _ap->writeBlocks->block_end();
+  }
+
+  _ap->writeSemaphore.notify();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::push(const void *ptr, size_t length)
+{
+  push(ptr, length, opcode::binary);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::push(const std::string &text)
+{
+  push(text.c_str(), text.length(), opcode::text);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::push_batch(const io_buffer *messages, size_t count, opcode op)
+{
+  batch b(*this);
+
+  for (size_t i = 0; i < count; ++i)
+    b.push(messages[i].ptr, messages[i].length, op);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::batch::batch(async_tcp_client &client)
+  : _client(client)
+{
+  _client._ap->messageMutex.lock();
+  _client._ap->writeBlocks.lock();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::batch::~batch()
+{
+  _client._ap->writeBlocks.unlock();
+  _client._ap->messageMutex.unlock();
+
+  if (_count)
+    _client._ap->writeSemaphore.notify(_count);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::batch::push(const void *ptr, size_t length, opcode op)
+{
+  if (!ptr)
+    return;
+
+  _client._ap->writeBlocks->block_begin(op);
+
+  if (!_client._ap->write_framed(ptr, length, true, true))
+    return;
+
+  _client._ap->writeBlocks->block_end();
+  ++_count;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::message_builder async_tcp_client::build_message(opcode op)
+{
+  return message_builder(*this, op);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::message_builder::message_builder(async_tcp_client &client, opcode op)
+  : _client(&client)
+  , _holdsMessage(op == opcode::text || op == opcode::binary)
+{
+  if (_holdsMessage)
+    _client->_ap->messageMutex.lock();
+
+  _client->_ap->writeBlocks.lock();
+  _client->_ap->writeBlocks->block_begin(op);
+
+  if (_client->_ap->framer)
+  {
+    _headerSize = _client->_ap->framer->max_header_size();
+    reserve(_headerSize);
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::message_builder::message_builder(message_builder &&other)
+  : _client(other._client)
+  , _holdsMessage(other._holdsMessage)
+  , _headerSize(other._headerSize)
+{
+  other._client = nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+async_tcp_client::message_builder::~message_builder()
+{
+  if (!_client)
+    return;
+
+  _client->_ap->writeBlocks->block_remove();
+  release();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::message_builder::write(const void *ptr, size_t length)
+{
+  if (_client && length)
+    memcpy(reserve(length), ptr, length);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+uint8_t *async_tcp_client::message_builder::reserve(size_t length)
+{
+  if (!_client)
+    return nullptr;
+
+  std::vector<uint8_t> &buffer = _client->_ap->writeBlocks->buffer;
+  buffer.resize(buffer.size() + length);
+  _client->_ap->writeBlocks->blocks.back().length += length;
+  return buffer.data() + buffer.size() - length;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::message_builder::size() const
+{
+  return _client ? _client->_ap->writeBlocks->blocks.back().length - _headerSize : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::message_builder::commit()
+{
+  if (!_client)
+    return false;
+
+  detail::async_tcp_client_impl &ap = *_client->_ap;
+
+  if (ap.framer)
+  {
+    data_block &db = ap.writeBlocks->blocks.back();
+    std::vector<uint8_t> &buffer = ap.writeBlocks->buffer;
+    size_t payloadLength = db.length - _headerSize;
+
+    uint8_t framing[message_framer::max_framing_size];
+    size_t headerSize = ap.framer->write_header(framing, payloadLength);
+
+    if (headerSize == invalid_operation)
+    {
+      ap.writeBlocks->block_remove();
+      release();
+      return false;
+    }
+
+    // Actual header may be shorter than the reserved space, payload moves next to it
+    uint8_t *start = buffer.data() + db.offset;
+    if (headerSize != _headerSize)
+    {
+      memmove(start + headerSize, start + _headerSize, payloadLength);
+      buffer.resize(db.offset + headerSize + payloadLength);
+      db.length = headerSize + payloadLength;
+    }
+
+    memcpy(start, framing, headerSize);
+    ap.writeBlocks->write(framing, ap.framer->write_trailer(framing));
+  }
+
+  ap.writeBlocks->block_end();
+  release();
+  ap.writeSemaphore.notify();
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::message_builder::release()
+{
+  _client->_ap->writeBlocks.unlock();
+
+  if (_holdsMessage)
+    _client->_ap->messageMutex.unlock();
+
+  _client = nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::begin_message(opcode op)
+{
+  _ap->messageMutex.lock();
+  _ap->streamOpcode = op;
+  _ap->streamFirst = true;
+  _ap->streamChunk.clear();
+  _ap->streamChunk.reserve(stream_chunk_size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::append(const void *ptr, size_t length)
+{
+  const uint8_t *cursor = reinterpret_cast<const uint8_t *>(ptr);
+  auto &chunk = _ap->streamChunk;
+
+  // Length prefix has to be known up front, the whole message is collected first
+  if (_ap->framer && _ap->framer->needs_length())
+  {
+    chunk.insert(chunk.end(), cursor, cursor + length);
+    return;
+  }
+
+  while (length && _p->isConnected)
+  {
+    // Whole chunks are queued straight from the caller's memory, without staging
+    if (chunk.empty() && length >= stream_chunk_size)
+    {
+      push_fragment(cursor, stream_chunk_size, false);
+      cursor += stream_chunk_size;
+      length -= stream_chunk_size;
+      continue;
+    }
+
+    size_t toCopy = stream_chunk_size - chunk.size();
+    toCopy = toCopy > length ? length : toCopy;
+    chunk.insert(chunk.end(), cursor, cursor + toCopy);
+    cursor += toCopy;
+    length -= toCopy;
+
+    if (chunk.size() == stream_chunk_size)
+    {
+      push_fragment(chunk.data(), chunk.size(), false);
+      chunk.clear();
+    }
+  }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::end_message()
+{
+  push_fragment(_ap->streamChunk.data(), _ap->streamChunk.size(), true);
+  _ap->streamChunk.clear();
+  _ap->messageMutex.unlock();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::set_framer(std::unique_ptr<message_framer> framer) { _ap->framer = std::move(framer); }
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::set_strand_delivery(bool enabled) { _ap->strandDelivery = enabled; }
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::deliver(const data_block &db, uint8_t *ptr, size_t length)
+{
+  std::weak_ptr<basic_tcp_client> self = _p->self;
+
+  if (!_ap->strandDelivery || self.expired())
+    return async_received_data(db, ptr, length);
+
+  auto data = std::make_shared<std::vector<uint8_t>>(ptr, ptr + length);
+  data_block copy = db;
+  copy.offset = 0;
+
+  post([self, copy, data]()
+  {
+    if (auto client = self.lock())
+      static_cast<async_tcp_client *>(client.get())->async_received_data(copy, data->data(), data->size());
+  });
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::push_fragment(const void *ptr, size_t length, bool isFinal)
+{
+  {
+    HEADSOCKET_LOCK(_ap->writeBlocks);
+    _ap->writeBlocks->block_begin(_ap->streamFirst ? _ap->streamOpcode : opcode::continuation).is_final = isFinal;
+
+    if (!_ap->write_framed(ptr, length, _ap->streamFirst, isFinal))
+      return;
+
+    _ap->writeBlocks->block_end();
+  }
+
+  _ap->streamFirst = false;
+  _ap->writeSemaphore.notify();
+
+  if (!isFinal)
+    wait_drained(stream_chunk_size);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::wait_drained(size_t limit)
+{
+  std::unique_lock<std::mutex> lock(_ap->drainMutex);
+  ++_ap->drainWaiters;
+
+  _ap->drained.wait(lock, [&]()->bool
+  {
+    if (!_p->isConnected)
+      return true;
+
+    HEADSOCKET_LOCK(_ap->writeBlocks);
+    return _ap->writeBlocks->buffer.size() <= limit;
+  });
+
+  --_ap->drainWaiters;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::wait_writable(size_t limit, std::function<void()> waiter)
+{
+  std::lock_guard<std::mutex> lock(_ap->drainMutex);
+
+  if (!_p->isConnected)
+    return false;
+
+  {
+    HEADSOCKET_LOCK(_ap->writeBlocks);
+
+    if (_ap->writeBlocks->buffer.size() <= limit)
+      return false;
+  }
+
+  _ap->asyncDrainWaiters.push_back({ limit, std::move(waiter) });
+  ++_ap->drainWaiters;
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::notify_drained(bool force)
+{
+  std::vector<std::function<void()>> waiters;
+
+  {
+    std::lock_guard<std::mutex> lock(_ap->drainMutex);
+
+    if (!_ap->asyncDrainWaiters.empty())
+    {
+      size_t pending = 0;
+      {
+        HEADSOCKET_LOCK(_ap->writeBlocks);
+        pending = _ap->writeBlocks->buffer.size();
+      }
+
+      size_t kept = 0;
+      for (size_t i = 0; i < _ap->asyncDrainWaiters.size(); ++i)
+      {
+        if (force || pending <= _ap->asyncDrainWaiters[i].limit)
+        {
+          waiters.push_back(std::move(_ap->asyncDrainWaiters[i].resume));
+          --_ap->drainWaiters;
+        }
+        else if (kept++ != i)
+          _ap->asyncDrainWaiters[kept - 1] = std::move(_ap->asyncDrainWaiters[i]);
+      }
+
+      _ap->asyncDrainWaiters.resize(kept);
+    }
+  }
+
+  _ap->drained.notify_all();
+
+  for (auto &waiter : waiters)
+    waiter();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::wait_readable(std::function<void()> waiter)
+{
+  HEADSOCKET_LOCK(_ap->readyMutex);
+
+  if (!_p->isConnected || _ap->inbound.front())
+    return false;
+
+  _ap->readWaiter = std::move(waiter);
+  _ap->readWaiting = true;
+
+  // Read thread could have published right before seeing the flag
+  if (_ap->inbound.front())
+  {
+    _ap->readWaiter = nullptr;
+    _ap->readWaiting = false;
+    return false;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::notify_readable(bool force)
+{
+  bool published = _ap->published;
+  _ap->published = false;
+
+  // Forced notification always takes the lock, waiter might be stored right now
+  if (!force && (!published || (!_ap->readWaiting && !_ap->readySleepers && !_ap->hasDataNotification)))
+    return;
+
+  std::function<void()> waiter;
+
+  {
+    HEADSOCKET_LOCK(_ap->readyMutex);
+
+    if (force || _ap->inbound.front())
+    {
+      waiter.swap(_ap->readWaiter);
+      _ap->readWaiting = false;
+    }
+
+    if (published && _ap->dataNotification)
+      _ap->dataNotification();
+  }
+
+  _ap->readyCv.notify_all();
+
+  if (waiter)
+    waiter();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::wait_data(uint32_t timeout)
+{
+  std::unique_lock<std::mutex> lock(_ap->readyMutex);
+  ++_ap->readySleepers;
+
+  _ap->readyCv.wait_for(lock, std::chrono::milliseconds(timeout), [this]()->bool
+  {
+    return _ap->inbound.front() || !_p->isConnected;
+  });
+
+  --_ap->readySleepers;
+  return _ap->inbound.front() != nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::wait_pop(void *ptr, size_t length, uint32_t timeout)
+{
+  return wait_data(timeout) ? pop(ptr, length) : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::set_data_notification(std::function<void()> callback)
+{
+  HEADSOCKET_LOCK(_ap->readyMutex);
+  _ap->hasDataNotification = callback != nullptr;
+  _ap->dataNotification = std::move(callback);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool async_tcp_client::pop_block(std::vector<uint8_t> &data)
+{
+  detail::inbound_message *msg = _ap->inbound.front();
+
+  if (!msg)
+    return false;
+
+  data.assign(msg->data.begin() + _ap->inboundOffset, msg->data.end());
+  _ap->inboundOffset = 0;
+  _ap->inbound.pop();
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::peek() const
+{
+  detail::inbound_message *msg = _ap->inbound.front();
+  return msg ? msg->data.size() - _ap->inboundOffset : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::pop(void *ptr, size_t length)
+{
+  if (!ptr)
+    return invalid_operation;
+
+  if (!length)
+    return 0;
+
+  detail::inbound_message *msg = _ap->inbound.front();
+
+  if (!msg)
+    return 0;
+
+  size_t available = msg->data.size() - _ap->inboundOffset;
+  size_t result = available > length ? length : available;
+  memcpy(ptr, msg->data.data() + _ap->inboundOffset, result);
+
+  // Rest of a partially read message is reported as continuation
+  if (result < available)
+  {
+    _ap->inboundOffset += result;
+    msg->op = opcode::continuation;
+  }
+  else
+  {
+    _ap->inboundOffset = 0;
+    _ap->inbound.pop();
+  }
+
+  return result;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::pop_batch(const std::function<void(opcode op, const uint8_t *ptr, size_t length)> &callback,
+                                   size_t max)
+{
+  if (!max)
+    return 0;
+
+  // First message might have been partially popped already
+  size_t offset = _ap->inboundOffset;
+  _ap->inboundOffset = 0;
+
+  return _ap->inbound.consume([&](detail::inbound_message &msg)
+  {
+    callback(msg.op, msg.data.data() + offset, msg.data.size() - offset);
+    offset = 0;
+  }, max);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::complete_block()
+{
+  data_block &db = _ap->readBlocks.blocks.back();
+  uint8_t *data = _ap->readBlocks.buffer.data() + db.offset;
+
+  if (!deliver(db, data, db.length))
+    _ap->publish(db.op, data, db.length);
+
+  _ap->readBlocks.block_remove();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::init_threads()
+{
+  _ap->threadCounter = 0;
+  _ap->writeThread = std::make_unique<std::thread>(std::bind(&async_tcp_client::write_thread, this));
+  _ap->readThread = std::make_unique<std::thread>(std::bind(&async_tcp_client::read_thread, this));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::write_thread()
+{
+  ++_ap->threadCounter;
+  detail::set_thread_name("AsyncTcpClient::writeThread");
+
+  std::vector<uint8_t> buffer(1024 * 1024);
+
+  while (_p->isConnected)
+  {
+    {
+      HEADSOCKET_LOCK(_ap->writeSemaphore);
+    }
+
+    if (!_p->isConnected)
+      break;
+
+    // Flushes as soon as half the buffer is filled, a partial one waits at most the coalesce delay
+    if (uint32_t delay = _p->coalesceDelay)
+    {
+      _ap->writeSemaphore.wait_for(std::chrono::microseconds(delay), [&]()->bool
+      {
+        if (!_p->isConnected)
+          return true;
+
+        HEADSOCKET_LOCK(_ap->writeBlocks);
+        return _ap->writeBlocks->buffer.size() >= buffer.size() / 2;
+      });
+    }
+
+    size_t written = async_write_handler(buffer.data(), buffer.size());
+
+    if (written == invalid_operation)
+      break;
+
+    if (_ap->drainWaiters)
+      notify_drained(false);
+
+    if (!written)
+      buffer.resize(buffer.size() * 2);
+    else
+    {
+      const char *cursor = reinterpret_cast<const char *>(buffer.data());
+
+      // Hint the kernel to hold back a partial segment when more blocks are already queued
+      int flags = _ap->writeSemaphore.count ? HEADSOCKET_MSG_MORE : 0;
+
+      while (written)
+      {
+        int result = ::send(_p->conn.impl()->socket, cursor, static_cast<int>(written), flags);
+
+        if (!result || result == detail::socket_error)
+          break;
+
+        cursor += result;
+        written -= static_cast<size_t>(result);
+      }
+    }
+
+    if (_ap->disconnectAfterFlush)
+      break;
+  }
+
+  kill_threads();
+  notify_drained(true);
+
+  --_ap->threadCounter;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::async_write_handler(uint8_t *ptr, size_t length)
+{
+  HEADSOCKET_LOCK(_ap->writeBlocks);
+
+  size_t numBlocks = 0;
+  size_t result = _ap->writeBlocks->read_blocks(ptr, length, numBlocks);
+
+  if (numBlocks)
+  {
+    _ap->writeSemaphore.consume(numBlocks);
+    return result;
+  }
+
+  // Front block does not fit into the buffer as a whole, send what we can
+  size_t toWrite = _ap->writeBlocks->peek(nullptr);
+  size_t toConsume = length > toWrite ? toWrite : length;
+  _ap->writeBlocks->read(ptr, toConsume);
+
+  if (toWrite == toConsume)
+    _ap->writeSemaphore.consume();
+
+  return toConsume;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t async_tcp_client::async_read_handler(uint8_t *ptr, size_t length)
+{
+  if (!_ap->framer)
+  {
+    _ap->publish(opcode::binary, ptr, length);
+    return length;
+  }
+
+  uint8_t *cursor = ptr;
+
+  while (length)
+  {
+    size_t payloadOffset = 0, payloadLength = 0;
+    size_t consumed = _ap->framer->read_message(cursor, length, payloadOffset, payloadLength);
+
+    if (consumed == invalid_operation)
+      return invalid_operation;
+    else if (!consumed)
+      break;
+
+    _ap->readBlocks.block_begin(opcode::binary);
+    _ap->readBlocks.write(cursor + payloadOffset, payloadLength);
+    _ap->readBlocks.block_end();
+    complete_block();
+
+    cursor += consumed;
+    length -= consumed;
+  }
+
+  return cursor - ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::read_thread()
+{
+  ++_ap->threadCounter;
+  detail::set_thread_name("AsyncTcpClient::readThread");
+
+  std::vector<uint8_t> buffer(1024 * 1024);
+  size_t bufferBytes = 0, consumed = 0;
+
+  while (_p->isConnected)
+  {
+    while (true)
+    {
+      int result = static_cast<int>(bufferBytes);
+
+      if (!result || !consumed)
+      {
+        result = recv(
+          _p->conn.impl()->socket,
+          reinterpret_cast<char *>(buffer.data() + bufferBytes),
+          static_cast<int>(buffer.size() - bufferBytes),
+          0);
+
+        if (!result || result == detail::socket_error)
+        {
+          consumed = invalid_operation;
+          break;
+        }
+
+        bufferBytes += static_cast<size_t>(result);
+        touch();
+      }
+
+      consumed = async_read_handler(buffer.data(), bufferBytes);
+      notify_readable(false);
+
+      if (!consumed)
+      {
+        if (bufferBytes == buffer.size())
+          buffer.resize(buffer.size() * 2);
+      }
+      else
+        break;
+    }
+
+    if (consumed == invalid_operation)
+      break;
+
+    bufferBytes -= consumed;
+
+    if (bufferBytes)
+      memcpy(buffer.data(), buffer.data() + consumed, bufferBytes);
+  }
+
+  kill_threads();
+  notify_readable(true);
+
+  --_ap->threadCounter;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void async_tcp_client::kill_threads()
+{
+  if (std::this_thread::get_id() == _ap->readThread->get_id())
+    _ap->writeSemaphore.notify();
+
+  disconnect();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------------------------------------------------
+web_socket_client::web_socket_client(const std::string &address, int port)
+  : base_t(address, port)
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+web_socket_client::web_socket_client(ptr<basic_tcp_server> server, connection &conn)
+  : base_t(server, conn)
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+web_socket_client::~web_socket_client()
+{
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t web_socket_client::peek(opcode *op) const
+{
+  detail::inbound_message *msg = _ap->inbound.front();
+
+  if (msg && op)
+    *op = msg->op;
+
+  return msg ? msg->data.size() - _ap->inboundOffset : 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void web_socket_client::close(uint16_t code)
+{
+  if (_ap->closing.exchange(true))
+    return;
+
+  uint8_t payload[2] = { static_cast<uint8_t>(code >> 8), static_cast<uint8_t>(code & 0xFF) };
+  push(payload, 2, opcode::connection_close);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void web_socket_client::on_keepalive()
+{
+  static const uint8_t empty = 0;
+  push(&empty, 0, opcode::ping);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t web_socket_client::async_write_handler(uint8_t *ptr, size_t length)
+{
+  uint8_t *cursor = ptr;
+  HEADSOCKET_LOCK(_ap->writeBlocks);
+
+  while (length >= 16 && _ap->writeBlocks->has_block())
+  {
+    opcode op;
+    size_t toWrite = _ap->writeBlocks->peek(&op);
+    size_t toConsume = (length - 15) > frame_size_limit ? frame_size_limit : (length - 15);
+    toConsume = toConsume > toWrite ? toWrite : toConsume;
+
+    frame_header header;
+    header.fin = (toWrite - toConsume) == 0 && _ap->writeBlocks->blocks.front().is_final;
+    header.op = op;
+    header.masked = false;
+    header.payload_length = toConsume;
+
+    size_t headerSize = header.write(cursor, length);
+    cursor += headerSize;
+    length -= headerSize;
+    _ap->writeBlocks->read(cursor, toConsume);
+    cursor += toConsume;
+    length -= toConsume;
+
+    if (toWrite == toConsume)
+      _ap->writeSemaphore.consume();
+
+    if (header.op == opcode::connection_close)
+    {
+      _ap->disconnectAfterFlush = true;
+      break;
+    }
+  }
+
+  return cursor - ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t web_socket_client::async_read_handler(uint8_t *ptr, size_t length)
+{
+  uint8_t *cursor = ptr;
+
+  // Close frame is on its way, anything else the peer sends is ignored
+  if (_ap->closing)
+    return length;
+
+  if (!_payload_size)
+  {
+    opcode prevOpcode = _current_header.op;
+    size_t headerSize = _current_header.read(cursor, length);
+
+    if (!headerSize)
+      return 0;
+    else if (headerSize == invalid_operation)
+      return invalid_operation;
+
+    _payload_size = _current_header.payload_length;
+    cursor += headerSize;
+    length -= headerSize;
+
+    if (_current_header.op != opcode::continuation)
+    {
+      _ap->readBlocks.block_begin(_current_header.op);
+
+      if (_current_header.op == opcode::text)
+        _utf8.reset();
+    }
+    else
+      _current_header.op = prevOpcode;
+  }
+
+  if (_payload_size)
+  {
+    size_t toConsume = length >= _payload_size ? _payload_size : length;
+
+    if (toConsume)
+    {
+      _ap->readBlocks.write(cursor, toConsume);
+      _payload_size -= toConsume;
+      cursor += toConsume;
+      length -= toConsume;
+    }
+  }
+
+  if (!_payload_size)
+  {
+    if (_current_header.masked)
+    {
+      data_block &db = _ap->readBlocks.blocks.back();
+      size_t len = _current_header.payload_length;
+      detail::utils::xor32(_current_header.masking_key, _ap->readBlocks.buffer.data() + _ap->readBlocks.buffer.size() - len, len);
+    }
+
+    if (_current_header.op == opcode::text && _validate_utf8)
+    {
+      size_t len = _current_header.payload_length;
+      bool valid = _utf8.validate(_ap->readBlocks.buffer.data() + _ap->readBlocks.buffer.size() - len, len);
+
+      if (!valid || (_current_header.fin && !_utf8.is_complete()))
+      {
+        _ap->readBlocks.block_remove();
+        close(1007);
+        return cursor - ptr;
+      }
+    }
+
+    if (_current_header.fin)
+    {
+      data_block &db = _ap->readBlocks.blocks.back();
+
+      switch (_current_header.op)
+      {
+        case opcode::ping:
+          push(_ap->readBlocks.buffer.data() + db.offset, db.length, opcode::pong);
+          break;
+
+        case opcode::text:
+          _ap->readBlocks.buffer.push_back(0);
+          ++db.length;
+          break;
+
+        case opcode::connection_close:
+          kill_threads();
+          break;
+
+        default:
+          break;
+      }
+
+      if (_current_header.op == opcode::text || _current_header.op == opcode::binary)
+      {
+        _ap->readBlocks.block_end();
+        complete_block();
+      }
+      else
+        _ap->readBlocks.block_remove();
+    }
+  }
+
+  return cursor - ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+#define HAVE_ENOUGH_BYTES(num) if (length < num) return 0; else length -= num;
+size_t web_socket_client::frame_header::read(const uint8_t *ptr, size_t length)
+{
+  const uint8_t *cursor = ptr;
+  HAVE_ENOUGH_BYTES(2);
+  this->fin = ((*cursor) & 0x80) != 0;
+  this->op = static_cast<opcode>((*cursor++) & 0x0F);
+
+  this->masked = ((*cursor) & 0x80) != 0;
+  uint8_t byte = (*cursor++) & 0x7F;
+
+  if (byte < 126)
+    this->payload_length = byte;
+  else if (byte == 126)
+  {
+    HAVE_ENOUGH_BYTES(2);
+    this->payload_length = detail::utils::swap16bits(*(reinterpret_cast<const uint16_t *>(cursor)));
+    cursor += 2;
+  }
+  else if (byte == 127)
+  {
+    HAVE_ENOUGH_BYTES(8);
+    uint64_t length64 = detail::utils::swap64bits(*(reinterpret_cast<const uint64_t *>(cursor))) & 0x7FFFFFFFFFFFFFFFULL;
+    this->payload_length = static_cast<size_t>(length64);
+    cursor += 8;
+  }
+
+  if (this->masked)
+  {
+    HAVE_ENOUGH_BYTES(4);
+    this->masking_key = *(reinterpret_cast<const uint32_t *>(cursor));
+    cursor += 4;
+  }
+
+  return cursor - ptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+size_t web_socket_client::frame_header::write(uint8_t *ptr, size_t length) const
+{
+  uint8_t *cursor = ptr;
+  HAVE_ENOUGH_BYTES(2);
+  *cursor = this->fin ? 0x80 : 0x00;
+  *cursor++ |= static_cast<uint8_t>(this->op);
+
+  *cursor = this->masked ? 0x80 : 0x00;
+
+  if (this->payload_length < 126)
+    *cursor++ |= static_cast<uint8_t>(this->payload_length);
+  else if (this->payload_length < 65536)
+  {
+    HAVE_ENOUGH_BYTES(2);
+    *cursor++ |= 126;
+    *reinterpret_cast<uint16_t *>(cursor) = detail::utils::swap16bits(static_cast<uint16_t>(this->payload_length));
+    cursor += 2;
+  }
+  else
+  {
+    HAVE_ENOUGH_BYTES(8);
+    *cursor++ |= 127;
+    *reinterpret_cast<uint64_t *>(cursor) = detail::utils::swap64bits(static_cast<uint64_t>(this->payload_length));
+    cursor += 8;
+  }
+
+  if (this->masked)
+  {
+    HAVE_ENOUGH_BYTES(4);
+    *reinterpret_cast<uint32_t *>(cursor) = this->masking_key;
+    cursor += 4;
+  }
+
+  return cursor - ptr;
+}
+#undef HAVE_ENOUGH_BYTES
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+// Builds response headers in a reusable buffer and sends them together with the body
+struct http_response_writer
+{
+  static const size_t chunk_size = 16 * 1024;
+
+  std::string head;
+  std::vector<char> chunk;
+
+  static string_ref status_line(int status)
+  {
+#define HEADSOCKET_STATUS_LINE(code, reason) \
+    case code: { static const char line[] = "HTTP/1.1 " #code " " reason "\r\n"; return string_ref(line, sizeof(line) - 1); }
+
+    switch (status)
+    {
+      HEADSOCKET_STATUS_LINE(101, "Switching Protocols")
+      HEADSOCKET_STATUS_LINE(200, "OK")
+      HEADSOCKET_STATUS_LINE(201, "Created")
+      HEADSOCKET_STATUS_LINE(202, "Accepted")
+      HEADSOCKET_STATUS_LINE(204, "No Content")
+      HEADSOCKET_STATUS_LINE(206, "Partial Content")
+      HEADSOCKET_STATUS_LINE(301, "Moved Permanently")
+      HEADSOCKET_STATUS_LINE(302, "Found")
+      HEADSOCKET_STATUS_LINE(303, "See Other")
+      HEADSOCKET_STATUS_LINE(304, "Not Modified")
+      HEADSOCKET_STATUS_LINE(307, "Temporary Redirect")
+      HEADSOCKET_STATUS_LINE(400, "Bad Request")
+      HEADSOCKET_STATUS_LINE(401, "Unauthorized")
+      HEADSOCKET_STATUS_LINE(403, "Forbidden")
+      HEADSOCKET_STATUS_LINE(404, "Not Found")
+      HEADSOCKET_STATUS_LINE(405, "Method Not Allowed")
+      HEADSOCKET_STATUS_LINE(408, "Request Timeout")
+      HEADSOCKET_STATUS_LINE(413, "Payload Too Large")
+      HEADSOCKET_STATUS_LINE(501, "Not Implemented")
+      HEADSOCKET_STATUS_LINE(503, "Service Unavailable")
+      default:
+      HEADSOCKET_STATUS_LINE(500, "Internal Server Error")
+    }
+#undef HEADSOCKET_STATUS_LINE
+  }
+
+  void begin(int status)
+  {
+    string_ref line = status_line(status);
+    head.assign(line.data, line.length);
+  }
+
+  void header(const string_ref &name, const string_ref &value)
+  {
+    head.append(name.data, name.length).append(": ", 2).append(value.data, value.length).append("\r\n", 2);
+  }
+
+  void header(const string_ref &name, size_t value)
+  {
+    char buffer[24];
+    head.append(name.data, name.length).append(": ", 2).append(buffer, format_number(buffer, value, 10)).append("\r\n", 2);
+  }
+
+  void end() { head.append("\r\n", 2); }
+
+  // Writes value into buffer (at least 24 bytes), returns number of characters
+  static size_t format_number(char *buffer, size_t value, size_t base)
+  {
+    char reversed[24];
+    size_t length = 0;
+
+    do
+    {
+      reversed[length++] = "0123456789abcdef"[value % base];
+      value /= base;
+    } while (value);
+
+    for (size_t i = 0; i < length; ++i)
+      buffer[i] = reversed[length - i - 1];
+
+    return length;
+  }
+
+  void begin(const http_handler::response &resp)
+  {
+    begin(resp.status);
+    header("Content-Type", resp.content_type);
+    header("Connection", "close");
+    head.append(resp.headers);
+  }
+
+  static bool has_body(int status) { return status >= 200 && status != 204 && status != 304; }
+
+  static string_ref body(const http_handler::response &resp)
+  {
+    if (!has_body(resp.status))
+      return string_ref();
+
+    return resp.static_body.data ? resp.static_body : string_ref(resp.message);
+  }
+
+  // Complete header block for response with body in message or static_body
+  void build_head(const http_handler::response &resp)
+  {
+    begin(resp);
+
+    if (has_body(resp.status))
+      header("Content-Length", body(resp).length);
+
+    end();
+  }
+
+  bool send(connection &conn, const http_request &req, const http_handler::response &resp)
+  {
+    if (!resp.generator || !has_body(resp.status))
+    {
+      build_head(resp);
+
+      string_ref content = body(resp);
+      io_buffer buffers[] = { { head.data(), head.length() }, { content.data, content.length } };
+      return conn.force_writev(buffers, 2);
+    }
+
+    begin(resp);
+
+    // HTTP/1.0 clients do not understand chunks, body is terminated by closing the connection instead
+    bool chunked = req.version != "HTTP/1.0";
+    if (chunked)
+      header("Transfer-Encoding", "chunked");
+
+    end();
+    chunk.resize(chunk_size);
+
+    for (bool headSent = false; ; headSent = true)
+    {
+      size_t length = resp.generator(chunk.data(), chunk.size());
+
+      char sizeLine[26];
+      size_t sizeLength = format_number(sizeLine, length, 16);
+      sizeLine[sizeLength++] = '\r';
+      sizeLine[sizeLength++] = '\n';
+
+      io_buffer buffers[4];
+      size_t count = 0;
+
+      if (!headSent)
+        buffers[count++] = { head.data(), head.length() };
+
+      if (chunked)
+      {
+        buffers[count++] = { sizeLine, sizeLength };
+        buffers[count++] = { chunk.data(), length };
+        buffers[count++] = { "\r\n", 2 };
+      }
+      else
+        buffers[count++] = { chunk.data(), length };
+
+      if (!conn.force_writev(buffers, count))
+        return false;
+
+      if (!length)
+        return true;
+    }
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Radix trie node, static nodes hold a compressed run of path characters. Capture nodes are shared by all patterns
+// capturing at that position, so capture names are kept by endpoints.
+struct route_node
+{
+  enum class node_type { static_text, segment, wildcard };
+
+  struct endpoint
+  {
+    std::string method;
+    http_handler::route_handler handler;
+    std::vector<std::string> captureNames;
+  };
+
+  node_type type = node_type::static_text;
+  std::string text;
+  std::vector<std::unique_ptr<route_node>> children;
+  std::vector<endpoint> endpoints;
+
+  route_node *child(node_type childType)
+  {
+    for (auto &c : children)
+      if (c->type == childType)
+        return c.get();
+
+    // Keep segment captures in front of wildcards, so they are matched first
+    auto it = children.end();
+    if (childType == node_type::segment && !children.empty() && children.back()->type == node_type::wildcard)
+      --it;
+
+    it = children.insert(it, std::make_unique<route_node>());
+    (*it)->type = childType;
+    return it->get();
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct http_handler_impl
+{
+  struct route_definition
+  {
+    std::string method;
+    std::string pattern;
+    http_handler::route_handler handler;
+  };
+
+  // Pre-serialized responses, one send is enough to answer a cached request
+  struct cache_entry
+  {
+    std::string etag;
+    std::string full;
+    std::string notModified;
+  };
+
+  std::mutex definitionsMutex;
+  std::vector<route_definition> definitions;
+  std::shared_ptr<const route_node> routes;
+
+  std::atomic<size_t> cacheCapacity = { 0 };
+  std::mutex cacheMutex;
+  std::unordered_map<std::string, std::shared_ptr<const cache_entry>> cache;
+
+  std::shared_ptr<const cache_entry> find_cached(const std::string &key)
+  {
+    HEADSOCKET_LOCK(cacheMutex);
+    auto it = cache.find(key);
+    return it != cache.end() ? it->second : nullptr;
+  }
+
+  void store_cached(const std::string &key, std::shared_ptr<const cache_entry> entry)
+  {
+    HEADSOCKET_LOCK(cacheMutex);
+
+    // No recency tracking, any entry makes room for the new one
+    while (!cache.empty() && cache.size() >= cacheCapacity)
+      cache.erase(cache.begin());
+
+    if (cacheCapacity)
+      cache[key] = entry;
+  }
+
+  static std::string make_etag(const std::string &body)
+  {
+    sha1 sha;
+    sha1::digest8_t digest;
+    sha.process_bytes(body.data(), body.length());
+    sha.get_digest_bytes(digest);
+
+    std::string etag(18, '"');
+    for (size_t i = 0; i < 8; ++i)
+    {
+      etag[1 + i * 2] = "0123456789abcdef"[digest[i] >> 4];
+      etag[2 + i * 2] = "0123456789abcdef"[digest[i] & 15];
+    }
+
+    return etag;
+  }
+
+  // If-None-Match uses weak comparison and can list several tags
+  static bool etag_matches(const string_ref &header, const string_ref &etag)
+  {
+    if (header == "*")
+      return true;
+
+    for (size_t i = 0; i + etag.length <= header.length; ++i)
+      if (!memcmp(header.data + i, etag.data, etag.length))
+        return true;
+
+    return false;
+  }
+
+  // Coding is acceptable when listed (or matched by "*") without zero quality
+  static bool accepts_encoding(const string_ref &header, const string_ref &coding)
+  {
+    const char *cursor = header.begin(), *end = header.end();
+
+    while (cursor < end)
+    {
+      const char *itemEnd = utils::find_char(cursor, end, ',');
+      const char *tokenEnd = utils::find_char(cursor, itemEnd, ';');
+
+      while (cursor < tokenEnd && *cursor == ' ') ++cursor;
+      string_ref token(cursor, tokenEnd - cursor);
+      while (!token.empty() && token[token.length - 1] == ' ') --token.length;
+
+      if (token == "*" || token.equals_nocase(coding))
+      {
+        for (const char *p = tokenEnd; p + 1 < itemEnd; ++p)
+          if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+          {
+            for (p += 2; p < itemEnd && (*p == '0' || *p == '.'); ++p);
+            return p < itemEnd && *p >= '1' && *p <= '9';
+          }
+
+        return true;
+      }
+
+      cursor = itemEnd + 1;
+    }
+
+    return false;
+  }
+
+  // Rebuilds the whole trie, readers keep using the previous one until it is published
+  void compile()
+  {
+    auto root = std::make_shared<route_node>();
+
+    for (auto &def : definitions)
+      insert(root.get(), def.pattern.c_str(), def.pattern.c_str() + def.pattern.length(), def);
+
+    std::atomic_store(&routes, std::shared_ptr<const route_node>(root));
+  }
+
+  static void insert(route_node *node, const char *pattern, const char *end, const route_definition &def)
+  {
+    std::vector<std::string> captureNames;
+
+    while (pattern < end)
+    {
+      if (*pattern == ':' || *pattern == '*')
+      {
+        bool segment = *pattern == ':';
+        const char *nameEnd = segment ? utils::find_char(pattern, end, '/') : end;
+
+        node = node->child(segment ? route_node::node_type::segment : route_node::node_type::wildcard);
+        captureNames.emplace_back(pattern + 1, nameEnd);
+
+        pattern = nameEnd;
+        continue;
+      }
+
+      // Static run ends right before a capture segment
+      const char *runEnd = pattern;
+      while (runEnd < end && !((*runEnd == ':' || *runEnd == '*') && runEnd[-1] == '/'))
+        ++runEnd;
+
+      node = insert_static(node, pattern, runEnd);
+      pattern = runEnd;
+    }
+
+    for (auto &ep : node->endpoints)
+      if (ep.method == def.method)
+      {
+        ep.handler = def.handler;
+        ep.captureNames = std::move(captureNames);
+        return;
+      }
+
+    node->endpoints.push_back({ def.method, def.handler, std::move(captureNames) });
+  }
+
+  static route_node *insert_static(route_node *node, const char *text, const char *end)
+  {
+    while (text < end)
+    {
+      std::unique_ptr<route_node> *found = nullptr;
 
-        if (!result || result == detail::socket_error)
+      for (auto &c : node->children)
+        if (c->type == route_node::node_type::static_text && c->text[0] == *text)
         {
-          consumed = invalid_operation;
+          found = &c;
           break;
         }
 
-        bufferBytes += static_cast<size_t>(result);
+      if (!found)
+      {
+        node->children.insert(node->children.begin(), std::make_unique<route_node>());
+        node->children.front()->text.assign(text, end);
+        return node->children.front().get();
       }
 
-      consumed = async_read_handler(buffer.data(), bufferBytes);
+      route_node *c = found->get();
+      size_t common = 0, length = end - text;
+      while (common < c->text.length() && common < length && c->text[common] == text[common])
+        ++common;
 
-      if (!consumed)
+      if (common < c->text.length())
       {
-        if (bufferBytes == buffer.size())
-          buffer.resize(buffer.size() * 2);
+        auto split = std::make_unique<route_node>();
+        split->text = c->text.substr(0, common);
+        c->text.erase(0, common);
+        split->children.push_back(std::move(*found));
+        *found = std::move(split);
+        c = found->get();
       }
-      else
-        break;
+
+      node = c;
+      text += common;
     }
 
-    if (consumed == invalid_operation)
-      break;
+    return node;
+  }
 
-    bufferBytes -= consumed;
+  // Static children are tried first, then segment captures, then wildcards
+  static const http_handler::route_handler *match(const route_node *node, const string_ref &method,
+    const char *path, const char *end, http_handler::parameters_t &captures)
+  {
+    if (path == end)
+    {
+      if (auto handler = find_endpoint(node, method, captures))
+        return handler;
+    }
 
-    if (bufferBytes)
-      memcpy(buffer.data(), buffer.data() + consumed, bufferBytes);
+    for (auto &c : node->children)
+    {
+      const http_handler::route_handler *result = nullptr;
+      size_t numCaptures = captures._count;
+
+      switch (c->type)
+      {
+      case route_node::node_type::static_text:
+        if (static_cast<size_t>(end - path) >= c->text.length() && !memcmp(path, c->text.data(), c->text.length()))
+          result = match(c.get(), method, path + c->text.length(), end, captures);
+        break;
+
+      case route_node::node_type::segment:
+      {
+        const char *segmentEnd = utils::find_char(path, end, '/');
+        if (segmentEnd != path && add_capture(captures, path, segmentEnd))
+          result = match(c.get(), method, segmentEnd, end, captures);
+        break;
+      }
+
+      case route_node::node_type::wildcard:
+        if (add_capture(captures, path, end))
+          result = find_endpoint(c.get(), method, captures);
+        break;
+      }
+
+      if (result)
+        return result;
+
+      captures._count = numCaptures;
+    }
+
+    return nullptr;
   }
 
-  kill_threads();
-  --_ap->threadCounter;
-}
+  // Captures are named once the endpoint is known, they are the last ones collected on the way here
+  static const http_handler::route_handler *find_endpoint(const route_node *node, const string_ref &method,
+    http_handler::parameters_t &captures)
+  {
+    for (auto &ep : node->endpoints)
+      if (ep.method == "*" || method == ep.method)
+      {
+        size_t first = captures._count - ep.captureNames.size();
+        for (size_t i = 0; i < ep.captureNames.size(); ++i)
+          captures._params[first + i].name = string_ref(ep.captureNames[i]);
 
-//---------------------------------------------------------------------------------------------------------------------
-void async_tcp_client::kill_threads()
-{
-  if (std::this_thread::get_id() == _ap->readThread->get_id())
-    _ap->writeSemaphore.notify();
+        return &ep.handler;
+      }
 
-  disconnect();
-}
+    return nullptr;
+  }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+  static bool add_capture(http_handler::parameters_t &captures, const char *begin, const char *end)
+  {
+    if (captures._count == http_handler::parameters_t::max_parameters)
+      return false;
 
-//---------------------------------------------------------------------------------------------------------------------
-web_socket_client::web_socket_client(const std::string &address, int port)
-  : base_t(address, port)
-{
+    http_handler::parameter &param = captures._params[captures._count++];
+    param.value = string_ref(begin, end - begin);
+    return true;
+  }
+};
 
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-web_socket_client::web_socket_client(ptr<basic_tcp_server> server, connection &conn)
-  : base_t(server, conn)
+http_handler::http_handler()
+  : _hp(std::make_unique<detail::http_handler_impl>())
 {
 
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-web_socket_client::~web_socket_client()
+http_handler::~http_handler()
 {
 
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-size_t web_socket_client::peek(opcode *op) const
+void http_handler::route(const std::string &method, const std::string &pattern, route_handler handler)
 {
-  HEADSOCKET_LOCK(_ap->readBlocks);
-  return _ap->readBlocks->peek(op);
+  std::string normalized = pattern;
+  if (normalized.empty() || normalized.front() != '/') normalized.insert(normalized.begin(), '/');
+  if (normalized.length() > 1 && normalized.back() == '/') normalized.pop_back();
+
+  HEADSOCKET_LOCK(_hp->definitionsMutex);
+  _hp->definitions.push_back({ method, normalized, handler });
+  _hp->compile();
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-size_t web_socket_client::async_write_handler(uint8_t *ptr, size_t length)
+void http_handler::route_asset(const std::string &path, const http_asset &asset)
 {
-  uint8_t *cursor = ptr;
-  HEADSOCKET_LOCK(_ap->writeBlocks);
+  const http_asset *a = &asset;
 
-  while (length >= 16)
+  route("GET", path, [a](const http_request &req, const parameters_t &captures, const parameters_t &params, response &resp)
   {
-    opcode op;
-    size_t toWrite = _ap->writeBlocks->peek(&op);
-    size_t toConsume = (length - 15) > frame_size_limit ? frame_size_limit : (length - 15);
-    toConsume = toConsume > toWrite ? toWrite : toConsume;
+    string_ref acceptEncoding = req.header("Accept-Encoding");
+    const http_asset::variant *selected = &a->identity;
+    const char *encoding = nullptr;
 
-    frame_header header;
-    header.fin = (toWrite - toConsume) == 0;
-    header.op = op;
-    header.masked = false;
-    header.payload_length = toConsume;
+    if (a->brotli.length && detail::http_handler_impl::accepts_encoding(acceptEncoding, "br"))
+    {
+      selected = &a->brotli;
+      encoding = "br";
+    }
+    else if (a->gzip.length && detail::http_handler_impl::accepts_encoding(acceptEncoding, "gzip"))
+    {
+      selected = &a->gzip;
+      encoding = "gzip";
+    }
 
-    size_t headerSize = header.write(cursor, length);
-    cursor += headerSize;
-    length -= headerSize;
-    _ap->writeBlocks->read(cursor, toConsume);
-    cursor += toConsume;
-    length -= toConsume;
+    // Strong validator has to differ for each encoding
+    char etag[64];
+    int etagLength = snprintf(etag, sizeof(etag), "\"%s%s%s\"", a->hash, encoding ? "-" : "", encoding ? encoding : "");
 
-    if (header.fin)
-      _ap->writeSemaphore.consume();
+    resp.content_type.assign(a->content_type);
+    resp.cacheable = false;
+    resp.add_header("ETag", string_ref(etag, etagLength));
+    resp.add_header("Vary", "Accept-Encoding");
 
-    if (!_ap->writeBlocks->peek(&op))
-      break;
-  }
+    if (detail::http_handler_impl::etag_matches(req.header("If-None-Match"), string_ref(etag, etagLength)))
+    {
+      resp.status = 304;
+      return true;
+    }
 
-  return cursor - ptr;
+    if (encoding)
+      resp.add_header("Content-Encoding", encoding);
+
+    resp.static_body = string_ref(static_cast<const char *>(selected->data), selected->length);
+    return true;
+  });
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-size_t web_socket_client::async_read_handler(uint8_t *ptr, size_t length)
+void http_handler::set_cache_size(size_t maxEntries)
 {
-  uint8_t *cursor = ptr;
-  HEADSOCKET_LOCK(_ap->readBlocks);
-
-  if (!_payload_size)
-  {
-    opcode prevOpcode = _current_header.op;
-    size_t headerSize = _current_header.read(cursor, length);
-
-    if (!headerSize)
-      return 0;
-    else if (headerSize == invalid_operation)
-      return invalid_operation;
+  _hp->cacheCapacity = maxEntries;
+  if (!maxEntries)
+    clear_cache();
+}
 
-    _payload_size = _current_header.payload_length;
-    cursor += headerSize;
-    length -= headerSize;
+//---------------------------------------------------------------------------------------------------------------------
+void http_handler::clear_cache()
+{
+  HEADSOCKET_LOCK(_hp->cacheMutex);
+  _hp->cache.clear();
+}
 
-    if (_current_header.op != opcode::continuation)
-      _ap->readBlocks->block_begin(_current_header.op);
-    else
-      _current_header.op = prevOpcode;
-  }
+//---------------------------------------------------------------------------------------------------------------------
+int http_handler::parameter::as_int(int defaultValue) const
+{
+  char buffer[32];
+  if (value.empty() || value.length >= sizeof(buffer))
+    return defaultValue;
 
-  if (_payload_size)
-  {
-    size_t toConsume = length >= _payload_size ? _payload_size : length;
+  memcpy(buffer, value.data, value.length);
+  buffer[value.length] = 0;
 
-    if (toConsume)
-    {
-      _ap->readBlocks->write(cursor, toConsume);
-      _payload_size -= toConsume;
-      cursor += toConsume;
-      length -= toConsume;
-    }
-  }
+  char *end = nullptr;
+  long result = strtol(buffer, &end, 10);
+  return end != buffer ? static_cast<int>(result) : defaultValue;
+}
 
-  if (!_payload_size)
-  {
-    if (_current_header.masked)
-    {
-      data_block &db = _ap->readBlocks->blocks.back();
-      size_t len = _current_header.payload_length;
-      detail::utils::xor32(_current_header.masking_key, _ap->readBlocks->buffer.data() + _ap->readBlocks->buffer.size() - len, len);
-    }
+//---------------------------------------------------------------------------------------------------------------------
+double http_handler::parameter::as_double(double defaultValue) const
+{
+  char buffer[64];
+  if (value.empty() || value.length >= sizeof(buffer))
+    return defaultValue;
 
-    if (_current_header.fin)
-    {
-      data_block &db = _ap->readBlocks->blocks.back();
+  memcpy(buffer, value.data, value.length);
+  buffer[value.length] = 0;
 
-      switch (_current_header.op)
-      {
-        case opcode::ping:
-          push(_ap->readBlocks->buffer.data() + db.offset, db.length, opcode::pong);
-          break;
+  char *end = nullptr;
+  double result = strtod(buffer, &end);
+  return end != buffer ? result : defaultValue;
+}
 
-        case opcode::text:
-          _ap->readBlocks->buffer.push_back(0);
-          ++db.length;
-          break;
+//---------------------------------------------------------------------------------------------------------------------
+bool http_handler::parameter::as_bool() const
+{
+  return as_int() != 0 || value.equals_nocase("true");
+}
 
-        case opcode::connection_close:
-          kill_threads();
-          break;
+//---------------------------------------------------------------------------------------------------------------------
+const http_handler::parameter *http_handler::parameters_t::find(const string_ref &name) const
+{
+  for (size_t i = 0; i < _count; ++i)
+    if (_params[i].name.equals_nocase(name))
+      return _params + i;
 
-        default:
-          break;
-      }
+  return nullptr;
+}
 
-      if (_current_header.op == opcode::text || _current_header.op == opcode::binary)
-      {
-        _ap->readBlocks->block_end();
+//---------------------------------------------------------------------------------------------------------------------
+bool http_server::handshake(connection &conn)
+{
+  http_request req;
 
-        if (async_received_data(db, _ap->readBlocks->buffer.data() + db.offset, db.length))
-          _ap->readBlocks->block_remove();
-      }
-    }
-  }
+  if (detail::read_http_request(conn, req))
+    respond(conn, req);
 
-  return cursor - ptr;
+  return false;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-#define HAVE_ENOUGH_BYTES(num) if (length < num) return 0; else length -= num;
-size_t web_socket_client::frame_header::read(const uint8_t *ptr, size_t length)
+void http_handler::respond(connection &conn, http_request &req)
 {
-  const uint8_t *cursor = ptr;
-  HAVE_ENOUGH_BYTES(2);
-  this->fin = ((*cursor) & 0x80) != 0;
-  this->op = static_cast<opcode>((*cursor++) & 0x0F);
+  // Key has to be taken before path and query are decoded
+  static thread_local std::string cacheKey;
+  bool useCache = _hp->cacheCapacity && req.method == "GET";
 
-  this->masked = ((*cursor) & 0x80) != 0;
-  uint8_t byte = (*cursor++) & 0x7F;
-
-  if (byte < 126)
-    this->payload_length = byte;
-  else if (byte == 126)
-  {
-    HAVE_ENOUGH_BYTES(2);
-    this->payload_length = detail::utils::swap16bits(*(reinterpret_cast<const uint16_t *>(cursor)));
-    cursor += 2;
-  }
-  else if (byte == 127)
+  if (useCache)
   {
-    HAVE_ENOUGH_BYTES(8);
-    uint64_t length64 = detail::utils::swap64bits(*(reinterpret_cast<const uint64_t *>(cursor))) & 0x7FFFFFFFFFFFFFFFULL;
-    this->payload_length = static_cast<size_t>(length64);
-    cursor += 8;
-  }
+    cacheKey.assign(req.target.data, req.target.length);
 
-  if (this->masked)
-  {
-    HAVE_ENOUGH_BYTES(4);
-    this->masking_key = *(reinterpret_cast<const uint32_t *>(cursor));
-    cursor += 4;
+    if (auto entry = _hp->find_cached(cacheKey))
+    {
+      const std::string &cached = detail::http_handler_impl::etag_matches(req.header("If-None-Match"), entry->etag) ?
+        entry->notModified : entry->full;
+
+      conn.force_write(cached.data(), cached.length());
+      return;
+    }
   }
 
-  return cursor - ptr;
-}
+  // Fields point into reader's buffer, so path and query can be decoded in place
+  req.path.length = detail::utils::url_decode_inplace(const_cast<char *>(req.path.data), req.path.length);
 
-//---------------------------------------------------------------------------------------------------------------------
-size_t web_socket_client::frame_header::write(uint8_t *ptr, size_t length) const
-{
-  uint8_t *cursor = ptr;
-  HAVE_ENOUGH_BYTES(2);
-  *cursor = this->fin ? 0x80 : 0x00;
-  *cursor++ |= static_cast<uint8_t>(this->op);
+  string_ref path = req.path;
+  if (!path.empty() && path[0] == '/') path = path.substr(1);
+  if (!path.empty() && path[path.length - 1] == '/') path = path.substr(0, path.length - 1);
 
-  *cursor = this->masked ? 0x80 : 0x00;
+  static thread_local parameters_t params;
+  params._count = 0;
 
-  if (this->payload_length < 126)
-    *cursor++ |= static_cast<uint8_t>(this->payload_length);
-  else if (this->payload_length < 65536)
-  {
-    HAVE_ENOUGH_BYTES(2);
-    *cursor++ |= 126;
-    *reinterpret_cast<uint16_t *>(cursor) = detail::utils::swap16bits(static_cast<uint16_t>(this->payload_length));
-    cursor += 2;
-  }
-  else
-  {
-    HAVE_ENOUGH_BYTES(8);
-    *cursor++ |= 127;
-    *reinterpret_cast<uint64_t *>(cursor) = detail::utils::swap64bits(static_cast<uint64_t>(this->payload_length));
-    cursor += 8;
-  }
+  const char *cursor = req.query.begin(), *queryEnd = req.query.end();
 
-  if (this->masked)
+  while (cursor < queryEnd && params._count < parameters_t::max_parameters)
   {
-    HAVE_ENOUGH_BYTES(4);
-    *reinterpret_cast<uint32_t *>(cursor) = this->masking_key;
-    cursor += 4;
-  }
+    const char *paramEnd = detail::utils::find_char(cursor, queryEnd, '&');
+    const char *valueBegin = detail::utils::find_char(cursor, paramEnd, '=');
+    char *name = const_cast<char *>(cursor);
+    char *value = const_cast<char *>(valueBegin < paramEnd ? valueBegin + 1 : paramEnd);
 
-  return cursor - ptr;
-}
-#undef HAVE_ENOUGH_BYTES
+    if (valueBegin != cursor)
+    {
+      parameter &param = params._params[params._count++];
+      param.name = string_ref(name, detail::utils::url_decode_inplace(name, valueBegin - cursor));
+      param.value = string_ref(value, detail::utils::url_decode_inplace(value, paramEnd - value));
+    }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    cursor = paramEnd + 1;
+  }
 
-namespace detail {
+  static thread_local parameters_t captures;
+  captures._count = 0;
 
-}
+  string_ref routePath = req.path;
+  if (routePath.length > 1 && routePath[routePath.length - 1] == '/') routePath.length--;
 
-//---------------------------------------------------------------------------------------------------------------------
-bool http_server::handshake(connection &conn)
-{
-  std::string requestLine;
+  // Keeps the trie alive while the handler runs, even if routes are changed meanwhile
+  std::shared_ptr<const detail::route_node> routes = std::atomic_load(&_hp->routes);
+  const route_handler *handler = nullptr;
 
-  if (!conn.read_line(requestLine))
-    return false;
+  if (routes)
+    handler = detail::http_handler_impl::match(routes.get(), req.method, routePath.begin(), routePath.end(), captures);
 
-  std::string headerLine;
-  while (conn.read_line(headerLine))
-  {
-    if (headerLine.empty())
-      break;
-  }
+  // Reused between requests, so building the response allocates only when it outgrows previous ones
+  static thread_local response resp;
+  static thread_local detail::http_response_writer writer;
 
-  std::string method = detail::utils::cut_front(requestLine);
-  std::string path = detail::utils::url_decode(detail::utils::cut_front(requestLine));
-  
-  if (!path.empty() && path.front() == '/') path = path.substr(1);
-  if (!path.empty() && path.back() == '/') path = path.substr(0, path.length() - 1);
+  resp.status = 200;
+  resp.content_type.assign("text/html");
+  resp.message.clear();
+  resp.headers.clear();
+  resp.static_body = string_ref();
+  resp.generator = nullptr;
+  resp.cacheable = true;
 
-  std::string params_get = detail::utils::cut_back(path, '?', false, false);
-  std::string version = detail::utils::cut_front(requestLine);
-  
-  parameters_t params;
-  std::string param_str;
-  while (!(param_str = detail::utils::cut_front(params_get, '&')).empty())
+  if (!(handler ? (*handler)(req, captures, params, resp) : (path != "favicon.ico" && request(path.str(), params, resp))))
   {
-    parameter param;
-    param.name = detail::utils::cut_front(param_str, '=');
-    param.value = param_str;
-    param.integer = atoi(param_str.c_str());
-    param.real = atof(param_str.c_str());
-    param.boolean = (param.integer != 0) || (param_str == "true");
-
-    params[param.name] = param;
+    resp.status = 404;
+    resp.message.clear();
+    resp.static_body = string_ref();
+    resp.headers.clear();
+    resp.generator = nullptr;
   }
 
-  response resp;
-  if (path != "favicon.ico" && request(path, params, resp))
+  if (useCache && resp.cacheable && resp.status == 200 && !resp.generator && !resp.static_body.data)
   {
-    std::stringstream ss;
-    ss << version << " 200 OK\n";
-    ss << "Content-Type: " << resp.content_type << "\n";
-    ss << "Content-Length: " << resp.message.length() << "\n\n";
-    ss << resp.message;
-
-    conn.write(ss.str());
+    auto entry = std::make_shared<detail::http_handler_impl::cache_entry>();
+    entry->etag = detail::http_handler_impl::make_etag(resp.message);
+    resp.add_header("ETag", entry->etag);
+
+    writer.build_head(resp);
+    entry->full.reserve(writer.head.length() + resp.message.length());
+    entry->full.append(writer.head).append(resp.message);
+
+    writer.begin(304);
+    writer.header("ETag", entry->etag);
+    writer.header("Connection", "close");
+    writer.end();
+    entry->notModified = writer.head;
+
+    _hp->store_cached(cacheKey, entry);
+    conn.force_write(entry->full.data(), entry->full.length());
   }
   else
-  {
-    conn.write(version);
-    conn.write(" 404 Not Found\n");
-  }
+    writer.send(conn, req, resp);
 
-  return false;
+  resp.generator = nullptr;
 }
 
 }
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <sstream>
 
 #define HEADSOCKET_IMPLEMENTATION
 #include <headsocket/headsocket.h>
@@ -40,38 +39,42 @@ public:
       if (_directoryStack.empty())
         _directoryStack.push_back("C:");
 
-      size_t count = 0;
-      std::stringstream json;
-      json << "{\n";
+      // Enumerate directory on top of directory stack first, the builder holds the sending queue while alive
+      struct entry
+      {
+        std::string fileName;
+        uint64_t size;
+        bool isDirectory;
+      };
+
+      std::vector<entry> entries;
 
       // Can we go one level up? If so, add ".." directory as our first JSON record
       if (_directoryStack.size() > 1)
+        entries.push_back({ "..", 0, true });
+
+      enumerateDirectory(_directoryStack.back(), false, [&](const std::string &fileName, uint64_t size, bool isDirectory)
       {
-        json << "  \"" << count << "\": { ";
-        json << "\"filename\": \"..\", ";
-        json << "\"size\": 0, ";
-        json << "\"isDirectory\": true";
-        json << " },\n";
+        entries.push_back({ escape(deUTFize(fileName)), size, isDirectory });
+      });
 
-        ++count;
-      }
+      // Serialize JSON response straight into the sending queue
+      auto json = build_message(headsocket::opcode::text);
+      json << "{\n";
 
-      // Enumerate directory on top of directory stack and construct JSON response on the fly
-      enumerateDirectory(_directoryStack.back(), false, [&](const std::string &fileName, uint64_t size, bool isDirectory)
+      for (size_t i = 0; i < entries.size(); ++i)
       {
-        json << "  \"" << count << "\": { ";
-        json << "\"filename\": \"" << escape(deUTFize(fileName)) << "\", ";
-        json << "\"size\": " << size << ", ";
-        json << "\"isDirectory\": " << (isDirectory ? "true" : "false");
+        json << "  \"" << i << "\": { ";
+        json << "\"filename\": \"" << entries[i].fileName << "\", ";
+        json << "\"size\": " << entries[i].size << ", ";
+        json << "\"isDirectory\": " << (entries[i].isDirectory ? "true" : "false");
         json << " },\n";
-
-        ++count;
-      });
+      }
 
       json << "  \"dir\": \"" << escape(_directoryStack.back()) << "\",";
-      json << "  \"count\": " << count << "\n}";
+      json << "  \"count\": " << entries.size() << "\n}";
 
-      push(json.str().c_str());
+      json.commit();
     }
     else if (cmd == "cd" && !param.empty())
     {
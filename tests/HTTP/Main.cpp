@@ -8,7 +8,14 @@
 
 class http : public headsocket::http_server
 {
-  HEADSOCKET_SERVER(http, headsocket::http_server) { }
+  HEADSOCKET_SERVER(http, headsocket::http_server)
+  {
+    route("GET", "/hello/:name", [](const headsocket::http_request &req, const parameters_t &captures, const parameters_t &params, response &resp)
+    {
+      resp.message = "Hello, " + captures.value("name").str() + "!<br>\n";
+      return true;
+    });
+  }
 
 public:
   bool request(const std::string &path, const parameters_t &params, response &resp) override
@@ -20,12 +27,12 @@ public:
     {
       resp.message += "Parameters:<br>\n";
 
-      for (auto &kvp : params)
+      for (auto &param : params)
       {
-        resp.message += kvp.first;
+        resp.message += param.name.str();
 
-        if (!kvp.second.value.empty())
-          resp.message += " = " + kvp.second.value;
+        if (!param.value.empty())
+          resp.message += " = " + param.value.str();
 
         resp.message += "<br>\n";
       }
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <chrono>
+
+#define HEADSOCKET_IMPLEMENTATION
+#include <headsocket/headsocket.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char *requests[] =
+{
+  "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n",
+
+  "GET /index.html?name=value&flag=true HTTP/1.1\r\n"
+  "Host: localhost:8080\r\n"
+  "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0 Safari/537.36\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n"
+  "Accept-Encoding: gzip, deflate, sdch, br\r\n"
+  "Accept-Language: en-US,en;q=0.8\r\n"
+  "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n",
+
+  "GET /chat HTTP/1.1\r\n"
+  "Host: localhost:42667\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: Upgrade\r\n"
+  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+  "Sec-WebSocket-Version: 13\r\n"
+  "\r\n",
+};
+
+int main(int argc, char *argv[])
+{
+  const size_t iterations = 1000000;
+
+  for (const char *text : requests)
+  {
+    size_t length = strlen(text);
+    headsocket::http_request req;
+    headsocket::detail::http_parser parser;
+    size_t checksum = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+      parser.reset();
+      checksum += parser.parse(text, length, req) + req.num_headers;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+
+    std::cout << req.method.str() << " " << req.path.str() << " (" << req.num_headers << " headers, " << length << " bytes): "
+              << ns << " ns/request, " << (1e9 / ns) << " requests/s per core, " << (length * 1000.0 / ns) << " MB/s ["
+              << checksum << "]" << std::endl;
+  }
+
+  std::cout << "Press ENTER to quit" << std::endl;
+  std::getchar();
+  return 0;
+}
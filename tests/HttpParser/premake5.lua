@@ -0,0 +1,7 @@
+project("HttpParser")
+
+generateProject(
+{
+  type = "console",
+	language = "C++",
+})
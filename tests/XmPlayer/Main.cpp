@@ -6,22 +6,7 @@
 
 #include "libxm/xm.h"
 
-static const char *xm_player_html =
-#include "XmPlayer.html.inl"
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-class http : public headsocket::http_server
-{
-  HEADSOCKET_SERVER(http, headsocket::http_server) { }
-
-public:
-  bool request(const std::string &path, const parameters_t &params, response &resp) override
-  {
-    resp.message = xm_player_html;
-    return true;
-  }
-};
+#include "XmPlayer.html.asset.inl"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -108,17 +93,22 @@ private:
   std::vector<float> _sampleBuffer;
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Serves the player page and its WebSocket stream on the same port
+class server : public headsocket::web_socket_http_server<client>
+{
+  HEADSOCKET_SERVER(server, headsocket::web_socket_http_server<client>)
+  {
+    route_asset("/", xm_player_html);
+  }
+};
+
 int main(int argc, char *argv[])
 {
-  auto host = http::create(8080);
+  auto host = server::create(8080);
   if (host->is_running())
-    std::cout << "HTTP server is running, open http://localhost:" << host->port() << " and dance!" << std::endl;
-  else
-    std::cout << "Could not start HTTP server!" << std::endl;
-
-  auto server = headsocket::web_socket_server<client>::create(42667);
-  if (server->is_running())
-    std::cout << "XM module server is running at port " << server->port() << std::endl;
+    std::cout << "XM module server is running, open http://localhost:" << host->port() << " and dance!" << std::endl;
   else
     std::cout << "Could not start server!" << std::endl;
 
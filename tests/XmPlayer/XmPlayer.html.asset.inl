@@ -0,0 +1,271 @@
+// Generated from XmPlayer.html by generateAssetSource, do not edit
+
+static const unsigned char xm_player_html_identity[] =
+{
+  0x3C, 0x21, 0x44, 0x4F, 0x43, 0x54, 0x59, 0x50, 0x45, 0x20, 0x68, 0x74, 0x6D, 0x6C, 0x3E, 0x0A,
+  0x3C, 0x68, 0x74, 0x6D, 0x6C, 0x3E, 0x0A, 0x3C, 0x68, 0x65, 0x61, 0x64, 0x3E, 0x0A, 0x20, 0x20,
+  0x3C, 0x6D, 0x65, 0x74, 0x61, 0x20, 0x63, 0x68, 0x61, 0x72, 0x73, 0x65, 0x74, 0x3D, 0x22, 0x75,
+  0x74, 0x66, 0x2D, 0x38, 0x22, 0x20, 0x2F, 0x3E, 0x0A, 0x20, 0x20, 0x3C, 0x74, 0x69, 0x74, 0x6C,
+  0x65, 0x3E, 0x58, 0x4D, 0x20, 0x50, 0x6C, 0x61, 0x79, 0x65, 0x72, 0x20, 0x65, 0x78, 0x61, 0x6D,
+  0x70, 0x6C, 0x65, 0x3C, 0x2F, 0x74, 0x69, 0x74, 0x6C, 0x65, 0x3E, 0x0A, 0x20, 0x20, 0x3C, 0x73,
+  0x74, 0x79, 0x6C, 0x65, 0x3E, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x62, 0x6F, 0x64, 0x79, 0x20, 0x7B,
+  0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62, 0x61, 0x63, 0x6B, 0x67, 0x72, 0x6F, 0x75, 0x6E,
+  0x64, 0x2D, 0x63, 0x6F, 0x6C, 0x6F, 0x72, 0x3A, 0x20, 0x23, 0x38, 0x30, 0x38, 0x30, 0x38, 0x30,
+  0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x6F, 0x6E, 0x74, 0x3A, 0x20, 0x31, 0x33,
+  0x70, 0x78, 0x20, 0x6D, 0x6F, 0x6E, 0x6F, 0x73, 0x70, 0x61, 0x63, 0x65, 0x3B, 0x0A, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x63, 0x6F, 0x6C, 0x6F, 0x72, 0x3A, 0x20, 0x23, 0x46, 0x46, 0x46, 0x46,
+  0x46, 0x46, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x3C, 0x2F, 0x73, 0x74,
+  0x79, 0x6C, 0x65, 0x3E, 0x0A, 0x3C, 0x2F, 0x68, 0x65, 0x61, 0x64, 0x3E, 0x0A, 0x3C, 0x62, 0x6F,
+  0x64, 0x79, 0x3E, 0x0A, 0x20, 0x20, 0x3C, 0x64, 0x69, 0x76, 0x20, 0x69, 0x64, 0x3D, 0x22, 0x63,
+  0x6F, 0x6E, 0x74, 0x65, 0x6E, 0x74, 0x22, 0x3E, 0x3C, 0x2F, 0x64, 0x69, 0x76, 0x3E, 0x0A, 0x3C,
+  0x2F, 0x62, 0x6F, 0x64, 0x79, 0x3E, 0x0A, 0x3C, 0x2F, 0x68, 0x74, 0x6D, 0x6C, 0x3E, 0x0A, 0x0A,
+  0x3C, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x20, 0x6C, 0x61, 0x6E, 0x67, 0x75, 0x61, 0x67, 0x65,
+  0x3D, 0x22, 0x6A, 0x61, 0x76, 0x61, 0x73, 0x63, 0x72, 0x69, 0x70, 0x74, 0x22, 0x20, 0x74, 0x79,
+  0x70, 0x65, 0x3D, 0x22, 0x74, 0x65, 0x78, 0x74, 0x2F, 0x6A, 0x61, 0x76, 0x61, 0x73, 0x63, 0x72,
+  0x69, 0x70, 0x74, 0x22, 0x3E, 0x0A, 0x20, 0x20, 0x63, 0x6F, 0x6E, 0x73, 0x6F, 0x6C, 0x65, 0x2E,
+  0x6C, 0x6F, 0x67, 0x28, 0x77, 0x69, 0x6E, 0x64, 0x6F, 0x77, 0x2E, 0x6C, 0x6F, 0x63, 0x61, 0x74,
+  0x69, 0x6F, 0x6E, 0x2E, 0x68, 0x72, 0x65, 0x66, 0x29, 0x3B, 0x0A, 0x0A, 0x20, 0x20, 0x76, 0x61,
+  0x72, 0x20, 0x63, 0x6F, 0x6E, 0x74, 0x65, 0x6E, 0x74, 0x20, 0x3D, 0x20, 0x64, 0x6F, 0x63, 0x75,
+  0x6D, 0x65, 0x6E, 0x74, 0x2E, 0x67, 0x65, 0x74, 0x45, 0x6C, 0x65, 0x6D, 0x65, 0x6E, 0x74, 0x42,
+  0x79, 0x49, 0x64, 0x28, 0x22, 0x63, 0x6F, 0x6E, 0x74, 0x65, 0x6E, 0x74, 0x22, 0x29, 0x3B, 0x0A,
+  0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x70, 0x6F, 0x72, 0x74, 0x20, 0x3D, 0x20, 0x77, 0x69, 0x6E,
+  0x64, 0x6F, 0x77, 0x2E, 0x6C, 0x6F, 0x63, 0x61, 0x74, 0x69, 0x6F, 0x6E, 0x2E, 0x70, 0x6F, 0x72,
+  0x74, 0x20, 0x3F, 0x20, 0x77, 0x69, 0x6E, 0x64, 0x6F, 0x77, 0x2E, 0x6C, 0x6F, 0x63, 0x61, 0x74,
+  0x69, 0x6F, 0x6E, 0x2E, 0x70, 0x6F, 0x72, 0x74, 0x20, 0x3A, 0x20, 0x38, 0x30, 0x38, 0x30, 0x3B,
+  0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72, 0x53, 0x69, 0x7A,
+  0x65, 0x20, 0x3D, 0x20, 0x34, 0x30, 0x39, 0x36, 0x3B, 0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20,
+  0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x20, 0x3D, 0x20, 0x5B,
+  0x5D, 0x3B, 0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x77, 0x73, 0x3B, 0x0A, 0x20, 0x20, 0x76,
+  0x61, 0x72, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65, 0x78, 0x74, 0x3B,
+  0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x50, 0x72, 0x6F, 0x63,
+  0x65, 0x73, 0x73, 0x6F, 0x72, 0x3B, 0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x61, 0x75, 0x64,
+  0x69, 0x6F, 0x53, 0x6F, 0x75, 0x72, 0x63, 0x65, 0x3B, 0x0A, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20,
+  0x74, 0x6F, 0x74, 0x61, 0x6C, 0x53, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x53, 0x74, 0x72, 0x65,
+  0x61, 0x6D, 0x65, 0x64, 0x20, 0x3D, 0x20, 0x30, 0x3B, 0x0A, 0x0A, 0x20, 0x20, 0x76, 0x61, 0x72,
+  0x20, 0x75, 0x72, 0x69, 0x20, 0x3D, 0x20, 0x22, 0x77, 0x73, 0x3A, 0x2F, 0x2F, 0x6C, 0x6F, 0x63,
+  0x61, 0x6C, 0x68, 0x6F, 0x73, 0x74, 0x22, 0x3B, 0x0A, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x77,
+  0x69, 0x6E, 0x64, 0x6F, 0x77, 0x2E, 0x6C, 0x6F, 0x63, 0x61, 0x74, 0x69, 0x6F, 0x6E, 0x2E, 0x68,
+  0x72, 0x65, 0x66, 0x2E, 0x73, 0x74, 0x61, 0x72, 0x74, 0x73, 0x57, 0x69, 0x74, 0x68, 0x28, 0x22,
+  0x68, 0x74, 0x74, 0x70, 0x22, 0x29, 0x29, 0x0A, 0x20, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x76, 0x61, 0x72, 0x20, 0x61, 0x72, 0x72, 0x20, 0x3D, 0x20, 0x77, 0x69, 0x6E, 0x64, 0x6F, 0x77,
+  0x2E, 0x6C, 0x6F, 0x63, 0x61, 0x74, 0x69, 0x6F, 0x6E, 0x2E, 0x68, 0x72, 0x65, 0x66, 0x2E, 0x73,
+  0x70, 0x6C, 0x69, 0x74, 0x28, 0x22, 0x2F, 0x22, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x75,
+  0x72, 0x69, 0x20, 0x3D, 0x20, 0x22, 0x77, 0x73, 0x3A, 0x2F, 0x2F, 0x22, 0x20, 0x2B, 0x20, 0x61,
+  0x72, 0x72, 0x5B, 0x32, 0x5D, 0x2E, 0x73, 0x70, 0x6C, 0x69, 0x74, 0x28, 0x22, 0x3A, 0x22, 0x29,
+  0x5B, 0x30, 0x5D, 0x3B, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x75, 0x72,
+  0x69, 0x20, 0x2B, 0x3D, 0x20, 0x22, 0x3A, 0x22, 0x20, 0x2B, 0x20, 0x70, 0x6F, 0x72, 0x74, 0x2E,
+  0x74, 0x6F, 0x53, 0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x0A, 0x20,
+  0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E, 0x20, 0x72, 0x67, 0x62, 0x32, 0x68, 0x65,
+  0x78, 0x28, 0x72, 0x2C, 0x20, 0x67, 0x2C, 0x20, 0x62, 0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20,
+  0x20, 0x69, 0x66, 0x20, 0x28, 0x67, 0x20, 0x21, 0x3D, 0x3D, 0x20, 0x75, 0x6E, 0x64, 0x65, 0x66,
+  0x69, 0x6E, 0x65, 0x64, 0x29, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x72, 0x65, 0x74,
+  0x75, 0x72, 0x6E, 0x20, 0x4E, 0x75, 0x6D, 0x62, 0x65, 0x72, 0x28, 0x30, 0x78, 0x31, 0x30, 0x30,
+  0x30, 0x30, 0x30, 0x30, 0x20, 0x2B, 0x20, 0x72, 0x20, 0x2A, 0x20, 0x30, 0x78, 0x31, 0x30, 0x30,
+  0x30, 0x30, 0x20, 0x2B, 0x20, 0x67, 0x20, 0x2A, 0x20, 0x30, 0x78, 0x31, 0x30, 0x30, 0x20, 0x2B,
+  0x20, 0x62, 0x29, 0x2E, 0x74, 0x6F, 0x53, 0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x31, 0x36, 0x29,
+  0x2E, 0x73, 0x75, 0x62, 0x73, 0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x31, 0x29, 0x3B, 0x0A, 0x20,
+  0x20, 0x20, 0x20, 0x65, 0x6C, 0x73, 0x65, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x72,
+  0x65, 0x74, 0x75, 0x72, 0x6E, 0x20, 0x4E, 0x75, 0x6D, 0x62, 0x65, 0x72, 0x28, 0x30, 0x78, 0x31,
+  0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x20, 0x2B, 0x20, 0x72, 0x5B, 0x30, 0x5D, 0x20, 0x2A, 0x20,
+  0x30, 0x78, 0x31, 0x30, 0x30, 0x30, 0x30, 0x20, 0x2B, 0x20, 0x72, 0x5B, 0x31, 0x5D, 0x20, 0x2A,
+  0x20, 0x30, 0x78, 0x31, 0x30, 0x30, 0x20, 0x2B, 0x20, 0x72, 0x5B, 0x32, 0x5D, 0x29, 0x2E, 0x74,
+  0x6F, 0x53, 0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x31, 0x36, 0x29, 0x2E, 0x73, 0x75, 0x62, 0x73,
+  0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x31, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20,
+  0x0A, 0x20, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E, 0x20, 0x72, 0x65, 0x6E, 0x64,
+  0x65, 0x72, 0x41, 0x75, 0x64, 0x69, 0x6F, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20,
+  0x20, 0x76, 0x61, 0x72, 0x20, 0x6F, 0x75, 0x74, 0x70, 0x75, 0x74, 0x42, 0x75, 0x66, 0x66, 0x65,
+  0x72, 0x20, 0x3D, 0x20, 0x65, 0x76, 0x65, 0x6E, 0x74, 0x2E, 0x6F, 0x75, 0x74, 0x70, 0x75, 0x74,
+  0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20,
+  0x4C, 0x20, 0x3D, 0x20, 0x6F, 0x75, 0x74, 0x70, 0x75, 0x74, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72,
+  0x2E, 0x67, 0x65, 0x74, 0x43, 0x68, 0x61, 0x6E, 0x6E, 0x65, 0x6C, 0x44, 0x61, 0x74, 0x61, 0x28,
+  0x30, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x52, 0x20, 0x3D, 0x20,
+  0x6F, 0x75, 0x74, 0x70, 0x75, 0x74, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x2E, 0x67, 0x65, 0x74,
+  0x43, 0x68, 0x61, 0x6E, 0x6E, 0x65, 0x6C, 0x44, 0x61, 0x74, 0x61, 0x28, 0x31, 0x29, 0x3B, 0x0A,
+  0x20, 0x20, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x6A, 0x20, 0x3D,
+  0x20, 0x30, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x66, 0x6F, 0x72, 0x20, 0x28, 0x76, 0x61, 0x72,
+  0x20, 0x69, 0x20, 0x3D, 0x20, 0x30, 0x3B, 0x20, 0x69, 0x20, 0x3C, 0x20, 0x6F, 0x75, 0x74, 0x70,
+  0x75, 0x74, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x2E, 0x6C, 0x65, 0x6E, 0x67, 0x74, 0x68, 0x3B,
+  0x20, 0x6A, 0x20, 0x2B, 0x3D, 0x20, 0x32, 0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x4C, 0x5B, 0x69, 0x5D, 0x20, 0x3D, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75,
+  0x66, 0x66, 0x65, 0x72, 0x5B, 0x6A, 0x5D, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x52,
+  0x5B, 0x69, 0x2B, 0x2B, 0x5D, 0x20, 0x3D, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75,
+  0x66, 0x66, 0x65, 0x72, 0x5B, 0x6A, 0x20, 0x2B, 0x20, 0x31, 0x5D, 0x3B, 0x0A, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x4C, 0x5B, 0x69, 0x5D, 0x20, 0x3D, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65,
+  0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x5B, 0x6A, 0x5D, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x52, 0x5B, 0x69, 0x2B, 0x2B, 0x5D, 0x20, 0x3D, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65,
+  0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x5B, 0x6A, 0x20, 0x2B, 0x20, 0x31, 0x5D, 0x3B, 0x0A, 0x20,
+  0x20, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x73, 0x61,
+  0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x20, 0x3D, 0x20, 0x73, 0x61, 0x6D,
+  0x70, 0x6C, 0x65, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x2E, 0x73, 0x6C, 0x69, 0x63, 0x65, 0x28,
+  0x6A, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72,
+  0x20, 0x6E, 0x65, 0x77, 0x53, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x20, 0x3D, 0x20, 0x34, 0x20,
+  0x2A, 0x20, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72, 0x53, 0x69, 0x7A, 0x65, 0x20, 0x2D, 0x20, 0x73,
+  0x61, 0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x3B, 0x0A, 0x20, 0x20, 0x20,
+  0x20, 0x69, 0x66, 0x20, 0x28, 0x6E, 0x65, 0x77, 0x53, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x20,
+  0x3E, 0x20, 0x30, 0x20, 0x26, 0x26, 0x20, 0x77, 0x73, 0x2E, 0x72, 0x65, 0x61, 0x64, 0x79, 0x53,
+  0x74, 0x61, 0x74, 0x65, 0x20, 0x3D, 0x3D, 0x20, 0x31, 0x29, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x77, 0x73, 0x2E, 0x73, 0x65, 0x6E, 0x64, 0x28, 0x6E, 0x65, 0x77, 0x53, 0x61, 0x6D, 0x70,
+  0x6C, 0x65, 0x73, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x66,
+  0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E, 0x20, 0x6F, 0x6E, 0x4F, 0x70, 0x65, 0x6E, 0x28, 0x65,
+  0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x77, 0x73, 0x2E, 0x73, 0x65, 0x6E, 0x64, 0x28,
+  0x61, 0x75, 0x64, 0x69, 0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65, 0x78, 0x74, 0x2E, 0x73, 0x61, 0x6D,
+  0x70, 0x6C, 0x65, 0x52, 0x61, 0x74, 0x65, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x20, 0x20,
+  0x0A, 0x20, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E, 0x20, 0x6F, 0x6E, 0x43, 0x6C,
+  0x6F, 0x73, 0x65, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x63, 0x6F, 0x6E,
+  0x74, 0x65, 0x6E, 0x74, 0x2E, 0x69, 0x6E, 0x6E, 0x65, 0x72, 0x48, 0x54, 0x4D, 0x4C, 0x20, 0x3D,
+  0x20, 0x22, 0x44, 0x69, 0x73, 0x63, 0x6F, 0x6E, 0x6E, 0x65, 0x63, 0x74, 0x65, 0x64, 0x2E, 0x2E,
+  0x2E, 0x22, 0x3B, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x0A, 0x20, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74,
+  0x69, 0x6F, 0x6E, 0x20, 0x64, 0x65, 0x71, 0x75, 0x61, 0x6E, 0x74, 0x69, 0x7A, 0x65, 0x28, 0x73,
+  0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x73, 0x69, 0x67, 0x6E,
+  0x20, 0x3D, 0x20, 0x28, 0x73, 0x20, 0x3E, 0x20, 0x30, 0x29, 0x20, 0x2D, 0x20, 0x28, 0x73, 0x20,
+  0x3C, 0x20, 0x30, 0x29, 0x20, 0x2B, 0x20, 0x30, 0x2E, 0x30, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6E, 0x20, 0x4D, 0x61, 0x74, 0x68, 0x2E, 0x70, 0x6F, 0x77, 0x28,
+  0x4D, 0x61, 0x74, 0x68, 0x2E, 0x61, 0x62, 0x73, 0x28, 0x73, 0x29, 0x2C, 0x20, 0x31, 0x2E, 0x30,
+  0x20, 0x2F, 0x20, 0x30, 0x2E, 0x32, 0x35, 0x29, 0x20, 0x2A, 0x20, 0x73, 0x69, 0x67, 0x6E, 0x3B,
+  0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x0A, 0x20, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E,
+  0x20, 0x6F, 0x6E, 0x4D, 0x65, 0x73, 0x73, 0x61, 0x67, 0x65, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x0A,
+  0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x69, 0x6E, 0x74, 0x38, 0x73, 0x20, 0x3D, 0x20,
+  0x6E, 0x65, 0x77, 0x20, 0x49, 0x6E, 0x74, 0x38, 0x41, 0x72, 0x72, 0x61, 0x79, 0x28, 0x65, 0x2E,
+  0x64, 0x61, 0x74, 0x61, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x76, 0x61, 0x72, 0x20, 0x73,
+  0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x20, 0x3D, 0x20, 0x69, 0x6E, 0x74, 0x38, 0x73, 0x2E, 0x6C,
+  0x65, 0x6E, 0x67, 0x74, 0x68, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x66, 0x6F, 0x72, 0x20, 0x28, 0x76, 0x61, 0x72, 0x20, 0x69, 0x20, 0x3D, 0x20, 0x30, 0x3B, 0x20,
+  0x69, 0x20, 0x3C, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x3B, 0x20, 0x2B, 0x2B, 0x69,
+  0x29, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x42, 0x75,
+  0x66, 0x66, 0x65, 0x72, 0x2E, 0x70, 0x75, 0x73, 0x68, 0x28, 0x64, 0x65, 0x71, 0x75, 0x61, 0x6E,
+  0x74, 0x69, 0x7A, 0x65, 0x28, 0x69, 0x6E, 0x74, 0x38, 0x73, 0x5B, 0x69, 0x5D, 0x20, 0x2F, 0x20,
+  0x31, 0x32, 0x37, 0x2E, 0x30, 0x29, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x0A,
+  0x20, 0x20, 0x20, 0x20, 0x74, 0x6F, 0x74, 0x61, 0x6C, 0x53, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73,
+  0x53, 0x74, 0x72, 0x65, 0x61, 0x6D, 0x65, 0x64, 0x20, 0x2B, 0x3D, 0x20, 0x73, 0x61, 0x6D, 0x70,
+  0x6C, 0x65, 0x73, 0x20, 0x2F, 0x20, 0x32, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x63, 0x6F, 0x6E,
+  0x74, 0x65, 0x6E, 0x74, 0x2E, 0x69, 0x6E, 0x6E, 0x65, 0x72, 0x48, 0x54, 0x4D, 0x4C, 0x20, 0x3D,
+  0x20, 0x22, 0x53, 0x74, 0x72, 0x65, 0x61, 0x6D, 0x69, 0x6E, 0x67, 0x20, 0x58, 0x4D, 0x20, 0x6D,
+  0x75, 0x73, 0x69, 0x63, 0x20, 0x66, 0x72, 0x6F, 0x6D, 0x3A, 0x20, 0x22, 0x20, 0x2B, 0x20, 0x75,
+  0x72, 0x69, 0x20, 0x2B, 0x20, 0x22, 0x3C, 0x62, 0x72, 0x20, 0x2F, 0x3E, 0x22, 0x3B, 0x0A, 0x20,
+  0x20, 0x20, 0x20, 0x63, 0x6F, 0x6E, 0x74, 0x65, 0x6E, 0x74, 0x2E, 0x69, 0x6E, 0x6E, 0x65, 0x72,
+  0x48, 0x54, 0x4D, 0x4C, 0x20, 0x2B, 0x3D, 0x20, 0x22, 0x4E, 0x75, 0x6D, 0x62, 0x65, 0x72, 0x20,
+  0x6F, 0x66, 0x20, 0x73, 0x74, 0x65, 0x72, 0x65, 0x6F, 0x20, 0x73, 0x61, 0x6D, 0x70, 0x6C, 0x65,
+  0x73, 0x20, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6D, 0x65, 0x64, 0x3A, 0x20, 0x22, 0x20, 0x2B, 0x20,
+  0x74, 0x6F, 0x74, 0x61, 0x6C, 0x53, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x73, 0x53, 0x74, 0x72, 0x65,
+  0x61, 0x6D, 0x65, 0x64, 0x2E, 0x74, 0x6F, 0x53, 0x74, 0x72, 0x69, 0x6E, 0x67, 0x28, 0x29, 0x3B,
+  0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x0A, 0x20, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E,
+  0x20, 0x6D, 0x61, 0x69, 0x6E, 0x28, 0x29, 0x20, 0x7B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x61, 0x75,
+  0x64, 0x69, 0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65, 0x78, 0x74, 0x20, 0x3D, 0x20, 0x6E, 0x65, 0x77,
+  0x20, 0x41, 0x75, 0x64, 0x69, 0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65, 0x78, 0x74, 0x28, 0x29, 0x3B,
+  0x0A, 0x20, 0x20, 0x20, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x50, 0x72, 0x6F, 0x63, 0x65, 0x73,
+  0x73, 0x6F, 0x72, 0x20, 0x3D, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65,
+  0x78, 0x74, 0x2E, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x53, 0x63, 0x72, 0x69, 0x70, 0x74, 0x50,
+  0x72, 0x6F, 0x63, 0x65, 0x73, 0x73, 0x6F, 0x72, 0x28, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72, 0x53,
+  0x69, 0x7A, 0x65, 0x2C, 0x20, 0x32, 0x2C, 0x20, 0x32, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x61, 0x75, 0x64, 0x69, 0x6F, 0x50, 0x72, 0x6F, 0x63, 0x65, 0x73, 0x73, 0x6F, 0x72, 0x2E, 0x6F,
+  0x6E, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x70, 0x72, 0x6F, 0x63, 0x65, 0x73, 0x73, 0x20, 0x3D, 0x20,
+  0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F, 0x6E, 0x20, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x20, 0x72,
+  0x65, 0x6E, 0x64, 0x65, 0x72, 0x41, 0x75, 0x64, 0x69, 0x6F, 0x28, 0x65, 0x29, 0x3B, 0x20, 0x7D,
+  0x0A, 0x20, 0x20, 0x20, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6F, 0x50, 0x72, 0x6F, 0x63, 0x65, 0x73,
+  0x73, 0x6F, 0x72, 0x2E, 0x63, 0x6F, 0x6E, 0x6E, 0x65, 0x63, 0x74, 0x28, 0x61, 0x75, 0x64, 0x69,
+  0x6F, 0x43, 0x6F, 0x6E, 0x74, 0x65, 0x78, 0x74, 0x2E, 0x64, 0x65, 0x73, 0x74, 0x69, 0x6E, 0x61,
+  0x74, 0x69, 0x6F, 0x6E, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x77, 0x73, 0x20, 0x3D, 0x20, 0x6E, 0x65, 0x77, 0x20, 0x57, 0x65, 0x62, 0x53, 0x6F, 0x63, 0x6B,
+  0x65, 0x74, 0x28, 0x75, 0x72, 0x69, 0x29, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x77, 0x73, 0x2E,
+  0x62, 0x69, 0x6E, 0x61, 0x72, 0x79, 0x54, 0x79, 0x70, 0x65, 0x20, 0x3D, 0x20, 0x22, 0x61, 0x72,
+  0x72, 0x61, 0x79, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72, 0x22, 0x3B, 0x0A, 0x20, 0x20, 0x20, 0x20,
+  0x77, 0x73, 0x2E, 0x6F, 0x6E, 0x6F, 0x70, 0x65, 0x6E, 0x20, 0x3D, 0x20, 0x66, 0x75, 0x6E, 0x63,
+  0x74, 0x69, 0x6F, 0x6E, 0x20, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x20, 0x6F, 0x6E, 0x4F, 0x70, 0x65,
+  0x6E, 0x28, 0x65, 0x29, 0x3B, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x77, 0x73, 0x2E, 0x6F,
+  0x6E, 0x63, 0x6C, 0x6F, 0x73, 0x65, 0x20, 0x3D, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F,
+  0x6E, 0x20, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x20, 0x6F, 0x6E, 0x43, 0x6C, 0x6F, 0x73, 0x65, 0x28,
+  0x65, 0x29, 0x3B, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x77, 0x73, 0x2E, 0x6F, 0x6E, 0x6D,
+  0x65, 0x73, 0x73, 0x61, 0x67, 0x65, 0x20, 0x3D, 0x20, 0x66, 0x75, 0x6E, 0x63, 0x74, 0x69, 0x6F,
+  0x6E, 0x20, 0x28, 0x65, 0x29, 0x20, 0x7B, 0x20, 0x6F, 0x6E, 0x4D, 0x65, 0x73, 0x73, 0x61, 0x67,
+  0x65, 0x28, 0x65, 0x29, 0x3B, 0x20, 0x7D, 0x0A, 0x20, 0x20, 0x7D, 0x0A, 0x0A, 0x20, 0x20, 0x77,
+  0x69, 0x6E, 0x64, 0x6F, 0x77, 0x2E, 0x61, 0x64, 0x64, 0x45, 0x76, 0x65, 0x6E, 0x74, 0x4C, 0x69,
+  0x73, 0x74, 0x65, 0x6E, 0x65, 0x72, 0x28, 0x22, 0x6C, 0x6F, 0x61, 0x64, 0x22, 0x2C, 0x20, 0x6D,
+  0x61, 0x69, 0x6E, 0x2C, 0x20, 0x66, 0x61, 0x6C, 0x73, 0x65, 0x29, 0x3B, 0x0A, 0x3C, 0x2F, 0x73,
+  0x63, 0x72, 0x69, 0x70, 0x74, 0x3E, 0x0A,
+};
+
+static const unsigned char xm_player_html_gzip[] =
+{
+  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xA5, 0x56, 0x6D, 0x6F, 0xDB, 0x36,
+  0x10, 0xFE, 0xEE, 0x5F, 0x71, 0xD5, 0x80, 0x42, 0x9A, 0x1D, 0xC9, 0xF6, 0xB6, 0x2E, 0xF3, 0xDB,
+  0xD0, 0x26, 0x19, 0x56, 0x20, 0x59, 0x83, 0x38, 0x40, 0x37, 0x18, 0xF9, 0x40, 0x49, 0xB4, 0xCC,
+  0x54, 0x22, 0x55, 0x92, 0x8A, 0xED, 0x0D, 0xF9, 0xEF, 0x3B, 0x52, 0x2F, 0x96, 0x1C, 0x07, 0x1D,
+  0x30, 0xD9, 0x80, 0xC8, 0x7B, 0xE7, 0xDD, 0x73, 0x27, 0xCE, 0xDE, 0x5C, 0x7E, 0xBA, 0xB8, 0xFF,
+  0xEB, 0xF6, 0x0A, 0x36, 0x3A, 0x4B, 0x17, 0xBD, 0x59, 0xFD, 0xA2, 0x24, 0x5E, 0xF4, 0x00, 0x66,
+  0x19, 0xD5, 0x04, 0xA2, 0x0D, 0x91, 0x8A, 0xEA, 0xB9, 0x53, 0xE8, 0xF5, 0xD9, 0xB9, 0x03, 0x81,
+  0x65, 0x69, 0xA6, 0x53, 0xBA, 0xF8, 0xF3, 0x06, 0x6E, 0x53, 0xB2, 0xA7, 0x12, 0xE8, 0x8E, 0x64,
+  0x79, 0x4A, 0x67, 0x41, 0xC9, 0x30, 0x22, 0x4A, 0xEF, 0xCB, 0x15, 0x40, 0x28, 0xE2, 0x3D, 0xFC,
+  0x63, 0x97, 0xB8, 0x21, 0xD1, 0x97, 0x44, 0x8A, 0x82, 0xC7, 0x67, 0x91, 0x48, 0x85, 0x9C, 0xC0,
+  0x77, 0xE7, 0x43, 0xF3, 0x9B, 0x56, 0x02, 0x6B, 0xC1, 0xF5, 0x04, 0x46, 0x3F, 0xE4, 0x3B, 0xC8,
+  0x04, 0x17, 0x2A, 0x27, 0x11, 0xAD, 0x79, 0xB5, 0xC6, 0x6F, 0xF6, 0x29, 0xA9, 0xCF, 0xC6, 0x5B,
+  0x50, 0xB9, 0x9B, 0x05, 0x65, 0xF8, 0x33, 0xE3, 0xD3, 0xC6, 0x11, 0xB3, 0x27, 0x60, 0xF1, 0xDC,
+  0x89, 0xD0, 0x2C, 0xE5, 0xDA, 0x59, 0xCC, 0x02, 0x24, 0x19, 0xC9, 0x52, 0x04, 0x35, 0xEC, 0xB9,
+  0x7B, 0x33, 0x15, 0x49, 0x96, 0x6B, 0x48, 0x09, 0x4F, 0x0A, 0x92, 0xD0, 0xB9, 0xF3, 0x48, 0x9E,
+  0x48, 0x49, 0x74, 0x40, 0xEF, 0x73, 0xA4, 0x68, 0xBA, 0xD3, 0x41, 0x8B, 0x6C, 0x3C, 0xA0, 0x61,
+  0x25, 0x52, 0xEA, 0xA7, 0x22, 0x71, 0xB7, 0x8C, 0xC7, 0x62, 0x8B, 0xCB, 0x88, 0x68, 0x26, 0xB8,
+  0xBF, 0x91, 0x74, 0xED, 0x4D, 0x7B, 0x28, 0xF5, 0x44, 0x24, 0x54, 0x21, 0xC0, 0x1C, 0x62, 0x11,
+  0x15, 0x19, 0x2E, 0xFD, 0x84, 0xEA, 0xAB, 0x94, 0x9A, 0xE5, 0x87, 0xFD, 0xC7, 0xD8, 0x6D, 0xA2,
+  0xF4, 0xA6, 0x95, 0x4E, 0x2E, 0xA4, 0x51, 0x38, 0x36, 0x6C, 0xC9, 0xBF, 0x9E, 0x26, 0x4F, 0xA0,
+  0x4E, 0xA7, 0x31, 0x10, 0x16, 0xEB, 0x35, 0x95, 0x4B, 0xF6, 0x37, 0x45, 0x33, 0x3F, 0x0E, 0x7F,
+  0x79, 0x57, 0x33, 0x94, 0x2D, 0xD9, 0x07, 0xCB, 0x46, 0xD6, 0xEA, 0xA1, 0x66, 0x6C, 0x55, 0xBD,
+  0x22, 0x45, 0xCC, 0xC4, 0x85, 0x09, 0x69, 0xA7, 0x3B, 0xB4, 0x5B, 0x29, 0x22, 0xAA, 0x94, 0x90,
+  0x1D, 0xEA, 0x52, 0x14, 0xB2, 0xAC, 0x95, 0x21, 0x69, 0xA1, 0x49, 0xBA, 0xB4, 0x4E, 0xD4, 0x52,
+  0x4B, 0x4A, 0x32, 0x1A, 0xA3, 0x9F, 0x61, 0x93, 0x8E, 0x42, 0x32, 0xDC, 0x3B, 0x5B, 0x35, 0x09,
+  0x02, 0x73, 0x82, 0x74, 0x23, 0x94, 0x76, 0x8C, 0x3A, 0x5B, 0xC3, 0xC9, 0x54, 0xFA, 0x4A, 0x13,
+  0xA9, 0xD5, 0x67, 0xA6, 0x37, 0xAE, 0xB3, 0xD1, 0x3A, 0x77, 0x3C, 0x0F, 0xC5, 0x4B, 0x68, 0xD9,
+  0x30, 0xA4, 0x3C, 0x91, 0xAC, 0x52, 0x35, 0x4F, 0x99, 0x76, 0x9D, 0xA0, 0x4C, 0x2D, 0x74, 0xBC,
+  0x3B, 0xD0, 0x37, 0xAA, 0xAB, 0xF1, 0x43, 0x2D, 0x36, 0x71, 0xBC, 0xD5, 0xD0, 0x66, 0xC4, 0xC0,
+  0xAB, 0x57, 0x8A, 0xF7, 0x51, 0x7E, 0x62, 0x64, 0x4D, 0x9A, 0x7D, 0x2D, 0xF0, 0x54, 0x8C, 0x27,
+  0xAE, 0x35, 0x88, 0xFF, 0x75, 0xC1, 0x23, 0xE3, 0x0F, 0x64, 0x12, 0x8E, 0x37, 0x74, 0xE7, 0xCA,
+  0x01, 0x24, 0x03, 0x08, 0xBD, 0x2A, 0x40, 0x73, 0xAA, 0x04, 0xDE, 0xCC, 0xE7, 0x80, 0xE0, 0xA7,
+  0x6B, 0xC6, 0x69, 0xEC, 0x41, 0x05, 0x6C, 0x49, 0x75, 0x21, 0x39, 0xFC, 0x51, 0x64, 0x21, 0x95,
+  0xEE, 0x70, 0x37, 0x1A, 0xDA, 0x07, 0x7D, 0x49, 0xF8, 0x1E, 0xAA, 0x3D, 0xEE, 0x92, 0x7A, 0x87,
+  0xEB, 0xD0, 0x3B, 0xC4, 0x30, 0x7A, 0xE7, 0xF9, 0xAA, 0x08, 0x55, 0xB5, 0xAB, 0xCE, 0x48, 0x53,
+  0x45, 0xFF, 0x83, 0x07, 0x3C, 0x69, 0xC7, 0x89, 0x5C, 0x8D, 0x1E, 0x5A, 0x7E, 0x4C, 0x5E, 0xBE,
+  0xE1, 0xEA, 0xF9, 0x38, 0x03, 0x14, 0x4F, 0x28, 0xDF, 0x1B, 0x50, 0xB8, 0xD4, 0x6B, 0x15, 0x48,
+  0x14, 0x3A, 0x2F, 0x74, 0x03, 0x3A, 0xFA, 0x64, 0x9A, 0xA0, 0x4D, 0x9C, 0x36, 0xA2, 0xD7, 0xC8,
+  0x6F, 0x73, 0x4C, 0xAF, 0x5C, 0x6C, 0x08, 0xE7, 0x34, 0xBD, 0x24, 0x9A, 0xB8, 0x43, 0xEF, 0x20,
+  0x7B, 0xF7, 0x0D, 0xD9, 0x3A, 0x21, 0x8D, 0xC2, 0x63, 0x89, 0xC4, 0x72, 0xDE, 0x48, 0x70, 0x0D,
+  0x8D, 0x59, 0x1A, 0xBE, 0x66, 0x5D, 0x5B, 0x29, 0xE5, 0x89, 0xDE, 0x4C, 0x51, 0x07, 0x01, 0x30,
+  0xF6, 0x9A, 0x49, 0x76, 0xBD, 0x62, 0x0F, 0xA8, 0xD2, 0xEE, 0xA3, 0xD5, 0xE3, 0x43, 0x3D, 0xAA,
+  0xEE, 0x56, 0xAC, 0xDF, 0x7F, 0xC9, 0xC7, 0x7C, 0x8E, 0x1A, 0x99, 0xFF, 0x6B, 0xE1, 0xF9, 0x70,
+  0xA8, 0xA3, 0x6E, 0x6E, 0x6F, 0x7D, 0x95, 0xB2, 0x88, 0xBA, 0x8F, 0xC7, 0x39, 0xE0, 0x74, 0x5B,
+  0xB5, 0xA7, 0x99, 0x0C, 0x58, 0xF0, 0xD6, 0xA8, 0x38, 0xEB, 0x58, 0x98, 0x36, 0xF8, 0x6D, 0xE9,
+  0x2C, 0x60, 0x08, 0x6F, 0xDF, 0xE2, 0xB4, 0xF0, 0xB1, 0xB7, 0xE3, 0xFD, 0x52, 0x13, 0x8D, 0x23,
+  0x66, 0x0E, 0x23, 0xAF, 0x8A, 0x1F, 0x39, 0x0A, 0x71, 0xD0, 0xD2, 0x39, 0x89, 0x15, 0xC1, 0x3F,
+  0xE5, 0x94, 0x1F, 0x60, 0x52, 0xAB, 0xB5, 0x87, 0x8F, 0x5F, 0x46, 0x73, 0x87, 0x2E, 0x5E, 0xB1,
+  0x71, 0x91, 0x0A, 0x45, 0x0F, 0x46, 0xAA, 0x39, 0xEA, 0x33, 0x84, 0x80, 0xFC, 0xFD, 0xFE, 0xC6,
+  0x80, 0xC9, 0xB9, 0x64, 0x0A, 0xE9, 0x9C, 0x46, 0x9A, 0xC6, 0xBE, 0xEF, 0x3B, 0xA5, 0xA5, 0xB6,
+  0x9D, 0x98, 0x7E, 0x2D, 0x08, 0xD7, 0x98, 0x01, 0x57, 0xB5, 0x61, 0xAB, 0x58, 0xC2, 0xD1, 0x82,
+  0x6B, 0x4F, 0xED, 0x61, 0x76, 0x70, 0x35, 0x33, 0xAB, 0x3E, 0x0C, 0xFD, 0x0A, 0x47, 0x55, 0x83,
+  0xDD, 0x10, 0xBD, 0xC1, 0x39, 0xBC, 0x75, 0xED, 0x82, 0x84, 0x0A, 0x2D, 0x0D, 0x60, 0xE4, 0x0F,
+  0x21, 0x40, 0xD9, 0xF1, 0x4F, 0x1E, 0x26, 0xDA, 0x98, 0x7B, 0xE9, 0x5C, 0xF0, 0x1B, 0x9C, 0xA9,
+  0xF8, 0xE5, 0xE9, 0xB6, 0x0C, 0xE3, 0xFA, 0xDC, 0x54, 0x08, 0xD3, 0x08, 0x1F, 0x71, 0xFD, 0x5E,
+  0x4A, 0xB2, 0x77, 0xA9, 0x1F, 0x23, 0xB0, 0x5B, 0x2D, 0xA0, 0x9A, 0x52, 0x5A, 0x85, 0x1A, 0xB5,
+  0x87, 0x92, 0x9F, 0xC2, 0x79, 0xA5, 0x34, 0x85, 0x7E, 0x9F, 0xD5, 0x65, 0xEB, 0x40, 0x27, 0x2F,
+  0xD4, 0xC6, 0x6D, 0x65, 0xC5, 0xDA, 0x36, 0xA8, 0x0D, 0x60, 0x34, 0xFE, 0xD9, 0x1F, 0x7A, 0x5E,
+  0x8D, 0x56, 0xFB, 0x3A, 0x39, 0xF3, 0xFB, 0xF3, 0x26, 0xB8, 0x00, 0xC6, 0xD3, 0xD7, 0xEB, 0x53,
+  0x6A, 0xE0, 0x54, 0x01, 0xBC, 0x59, 0x64, 0x85, 0x62, 0x11, 0xAC, 0xA5, 0xC8, 0x26, 0x60, 0x66,
+  0xAE, 0x1D, 0xC0, 0xE0, 0xCC, 0x42, 0x89, 0x77, 0x10, 0xE7, 0x35, 0x2B, 0x66, 0x44, 0x97, 0x23,
+  0x0E, 0xC4, 0x1A, 0x94, 0xA6, 0x92, 0x8A, 0xC6, 0xBB, 0xAA, 0x22, 0x2A, 0x0D, 0x9E, 0x8A, 0xF5,
+  0x68, 0xA8, 0x77, 0xEB, 0x93, 0x11, 0xC6, 0xDD, 0xBA, 0x32, 0x6D, 0x74, 0x56, 0xC5, 0x79, 0xDF,
+  0x22, 0xB9, 0x55, 0x5E, 0xBA, 0x5F, 0x4B, 0x14, 0xEC, 0xA0, 0x3A, 0x42, 0xAF, 0x9A, 0x2E, 0xED,
+  0x5D, 0xA2, 0x11, 0x72, 0x0F, 0x6D, 0x38, 0x80, 0x31, 0xFE, 0x4F, 0x9A, 0xF2, 0x05, 0xB7, 0x84,
+  0xBC, 0x24, 0xA0, 0xE5, 0x26, 0x4E, 0x0B, 0x9F, 0xA3, 0x11, 0x3C, 0xAD, 0x66, 0xC5, 0x91, 0x91,
+  0xAA, 0x1D, 0xBA, 0xBD, 0x16, 0x53, 0xA5, 0x19, 0xB7, 0x9F, 0xCE, 0xF6, 0xC8, 0xD8, 0xD6, 0x20,
+  0xFC, 0x4C, 0xC3, 0xA5, 0x88, 0xBE, 0x50, 0xED, 0x62, 0x4D, 0x2A, 0x09, 0x6C, 0xDA, 0x10, 0x75,
+  0xE4, 0xFE, 0x1E, 0xEF, 0x49, 0xA6, 0x96, 0xC4, 0xA0, 0xB4, 0x3C, 0x89, 0xD3, 0x88, 0xE0, 0x75,
+  0x0E, 0x5B, 0xFD, 0x65, 0xAC, 0xCD, 0x08, 0xA8, 0xC3, 0xB4, 0xB2, 0x91, 0x69, 0xE9, 0x53, 0xC2,
+  0x75, 0xAF, 0x77, 0xA4, 0xB3, 0xB2, 0x77, 0x4E, 0xC9, 0x1F, 0xDA, 0xAA, 0xD4, 0xB0, 0x65, 0xAD,
+  0x2E, 0x09, 0x24, 0x8E, 0xAF, 0xCC, 0x47, 0xE8, 0x9A, 0x21, 0x58, 0x10, 0x45, 0xAE, 0x93, 0x0A,
+  0x12, 0x3B, 0x03, 0x5B, 0xED, 0x01, 0xAC, 0x09, 0x7E, 0x42, 0xF1, 0x8C, 0x78, 0xC1, 0xB4, 0x55,
+  0x5A, 0xF4, 0xFE, 0x05, 0x9E, 0xA1, 0xB3, 0x94, 0x37, 0x0B, 0x00, 0x00,
+};
+
+static const headsocket::http_asset xm_player_html =
+{
+  "text/html", "b120b723d104b138",
+  { xm_player_html_identity, 2871 },
+  { xm_player_html_gzip, 1180 },
+  { nullptr, 0 },
+};
@@ -1,6 +1,6 @@
 project("XmPlayer")
 
-generateStringSource("XmPlayer.html")
+generateAssetSource("XmPlayer.html", "xm_player_html")
 
 generateProject(
 {
@@ -1,3 +1,4 @@
 include "DirList"
 include "HTTP"
+include "HttpParser"
 include "XmPlayer"